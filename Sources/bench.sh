@@ -0,0 +1,84 @@
+#!/bin/bash
+
+# Compares the host run time of simulator builds on the big benchmarks and on
+# generated workloads long enough that start-up does not dominate. The first binary
+# is the reference the others are reported relative to.
+#
+# The cost of the detailed counters is the bench_instrumented target, which runs
+#   ./bench.sh 5 <build>/riscv_sim <build>/riscv_sim_instrumented
+# To compare with a build from before some change instead, build both Release:
+#   git worktree add /tmp/baseline <commit>
+#   cmake -S /tmp/baseline/Sources -B /tmp/baseline/build -DCMAKE_BUILD_TYPE=Release
+#   cmake --build /tmp/baseline/build --target riscv_sim
+#   ./bench.sh 5 /tmp/baseline/build/riscv_sim build/riscv_sim
+# (builds from before --generate exit at once on the generated rows, so only the
+# big benchmark rows compare there)
+
+runs=$1
+shift
+exe_files=("$@")
+
+if [ -z "$runs" ] || [ ${#exe_files[@]} -eq 0 ]; then
+    echo "Usage: $0 RUNS REFERENCE_BIN [BIN...]"
+    exit 1
+fi
+
+vmh_dir=programs/build/bigbenchmarks/bin
+bench_tests=(
+        median
+        multiply
+        qsort
+        vvadd
+     )
+# name and --generate spec
+bench_generated=(
+        deps    deps:length=64,chains=4,iterations=20000
+        chase   chase:footprint=262144,steps=400000
+        branch  branch:iterations=1000000
+        calls   calls:depth=16,calls=100000
+        stream  stream:footprint=1048576,passes=4
+     )
+
+# best of $runs wall clock times in microseconds of running "$@"
+best_time() {
+    local best=
+    for ((i = 0; i < runs; i++)); do
+        local start=$(date +%s%N)
+        "$@" > /dev/null 2>&1
+        local end=$(date +%s%N)
+        local us=$(((end - start) / 1000))
+        if [ -z "$best" ] || [ $us -lt $best ]; then
+            best=$us
+        fi
+    done
+    echo $best
+}
+
+printf "%-10s" "benchmark"
+for exe_file in "${exe_files[@]}"; do
+    printf " %24s" "$(basename $(dirname $exe_file))/$(basename $exe_file)"
+done
+echo
+
+# one row: the name, then the arguments of every binary
+bench_row() {
+    local name=$1
+    shift
+    printf "%-10s" $name
+    local ref=
+    for exe_file in "${exe_files[@]}"; do
+        local us=$(best_time $exe_file "$@")
+        if [ -z "$ref" ]; then
+            ref=$us
+        fi
+        printf " %14d us (%4d%%)" $us $((us * 100 / ref))
+    done
+    echo
+}
+
+for test_name in ${bench_tests[@]}; do
+    bench_row $test_name ${vmh_dir}/${test_name}.riscv
+done
+for ((g = 0; g < ${#bench_generated[@]}; g += 2)); do
+    bench_row ${bench_generated[g]} --generate ${bench_generated[g + 1]}
+done
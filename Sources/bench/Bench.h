@@ -0,0 +1,121 @@
+#ifndef RISCV_SIM_BENCH_H
+#define RISCV_SIM_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <dirent.h>
+
+// Shared by the host-side benchmarks: repeated timing, and baseline files for flagging
+// regressions. A baseline is one "name value" line per benchmark, where the value is
+// the best time of the runs: other load on the host only ever adds time, so the best
+// run is what moves least between invocations
+
+// Keeps the compiler from optimizing away a value computed only for timing
+template<typename T>
+static inline void Consume(const T &value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchResult
+{
+	std::string name;
+	double best = 0;
+	// Median over the runs, and the median absolute deviation as a share of it
+	double median = 0;
+	double spread = 0;
+};
+
+static double Seconds(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+	return std::chrono::duration<double>(to - from).count();
+}
+
+static BenchResult Summarize(const std::string &name, std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	double median = samples[samples.size() / 2];
+	std::vector<double> deviations;
+	for (double sample : samples)
+		deviations.push_back(std::fabs(sample - median));
+	std::sort(deviations.begin(), deviations.end());
+	return {name, samples.front(), median, median ? deviations[deviations.size() / 2] / median : 0};
+}
+
+static bool SaveBaseline(const std::string &filename, const std::vector<BenchResult> &results)
+{
+	FILE *out = fopen(filename.c_str(), "w");
+	if (out == nullptr)
+	{
+		fprintf(stderr, "ERROR: failed opening baseline file \"%s\"\n", filename.c_str());
+		return false;
+	}
+	for (const BenchResult &result : results)
+		fprintf(out, "%s %.6g\n", result.name.c_str(), result.best);
+	return fclose(out) == 0;
+}
+
+// Prints every result slower than the baseline by more than `thresholdPercent` and
+// returns false if there is any. Benchmarks missing on either side are skipped
+static bool CompareBaseline(const std::string &filename, const std::vector<BenchResult> &results,
+                            double thresholdPercent)
+{
+	std::ifstream in(filename);
+	if (!in)
+	{
+		fprintf(stderr, "ERROR: failed opening baseline file \"%s\"\n", filename.c_str());
+		return false;
+	}
+	std::map<std::string, double> baseline;
+	std::string name;
+	double value;
+	while (in >> name >> value)
+		baseline[name] = value;
+
+	bool ok = true;
+	for (const BenchResult &result : results)
+	{
+		auto found = baseline.find(result.name);
+		if (found == baseline.end() || found->second <= 0)
+			continue;
+		double change = 100.0 * (result.best - found->second) / found->second;
+		if (change > thresholdPercent)
+		{
+			fprintf(stderr, "REGRESSION: %s %.6g -> %.6g (+%.1f%%)\n", result.name.c_str(), found->second,
+			        result.best, change);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// The ELF programs of the suites under `dir`
+static std::vector<std::string> ListPrograms(const std::string &dir)
+{
+	std::vector<std::string> programs;
+	for (const char *suite : {"assembly", "smallbenchmarks", "bigbenchmarks"})
+	{
+		std::string suiteDir = dir + "/" + suite + "/bin";
+		DIR *d = opendir(suiteDir.c_str());
+		if (d == nullptr)
+			continue;
+		while (dirent *entry = readdir(d))
+		{
+			std::string name = entry->d_name;
+			// towers is left out of test.sh as well: it stores outside guest memory
+			if (name.size() > 6 && name.compare(name.size() - 6, 6, ".riscv") == 0 && name != "towers.riscv")
+				programs.push_back(suiteDir + "/" + name);
+		}
+		closedir(d);
+	}
+	std::sort(programs.begin(), programs.end());
+	return programs;
+}
+
+#endif //RISCV_SIM_BENCH_H
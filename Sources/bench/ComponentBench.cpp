@@ -0,0 +1,321 @@
+// Microbenchmarks of the simulator's hot components, timed in host nanoseconds per item:
+// the decoder, executor and register file over the instruction mix of the shipped
+// programs, the hit and miss paths of CachedMemory, and ELF loading
+
+#include "Bench.h"
+#include "Cpu.h"
+#include "Decoder.h"
+#include "Executor.h"
+#include "Host.h"
+#include "RegisterFile.h"
+#include "Memory/CachedMemory.h"
+#include "Memory/MemoryStorage.h"
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+struct BenchOptions
+{
+	int runs = 9;
+	std::string programs = "programs/build";
+	std::string filter;
+	std::string saveFile;
+	std::string compareFile;
+	double threshold = 10;
+};
+
+class ComponentBench
+{
+public:
+	explicit ComponentBench(const BenchOptions &opts)
+			: _opts(opts)
+	{
+		printf("%-28s %12s %12s %8s\n", "benchmark", "best ns", "median ns", "spread");
+	}
+
+	// Times `body`, which handles `items` items per call. Each sample is a batch of
+	// calls long enough to drown the timer overhead
+	template<typename F>
+	void Run(const std::string &name, size_t items, F &&body)
+	{
+		if (!_opts.filter.empty() && name.find(_opts.filter) == std::string::npos)
+			return;
+
+		using Clock = std::chrono::steady_clock;
+		size_t calls = 1;
+		while (true)
+		{
+			Clock::time_point start = Clock::now();
+			for (size_t i = 0; i < calls; i++)
+				body();
+			if (Seconds(start, Clock::now()) >= minBatchSeconds)
+				break;
+			calls *= 2;
+		}
+
+		std::vector<double> samples;
+		for (int run = 0; run < _opts.runs; run++)
+		{
+			Clock::time_point start = Clock::now();
+			for (size_t i = 0; i < calls; i++)
+				body();
+			samples.push_back(1e9 * Seconds(start, Clock::now()) / double(calls * items));
+		}
+
+		BenchResult result = Summarize(name, samples);
+		printf("%-28s %12.2f %12.2f %7.1f%%\n", name.c_str(), result.best, result.median, 100 * result.spread);
+		fflush(stdout);
+		_results.push_back(result);
+	}
+
+	const std::vector<BenchResult> &Results() const
+	{
+		return _results;
+	}
+
+private:
+	static constexpr double minBatchSeconds = 0.02;
+
+	const BenchOptions &_opts;
+	std::vector<BenchResult> _results;
+};
+
+// Instruction words the programs execute, up to maxPerProgram of each, so that the mix
+// is weighted the way the simulator sees it. An evenly spaced sample of mixSize words is
+// kept, small enough for the decoded instructions to stay in the host caches
+static std::vector<Word> CollectMix(const std::vector<std::string> &programs)
+{
+	static constexpr size_t maxPerProgram = 100000;
+	static constexpr size_t mixSize = 16384;
+
+	std::vector<Word> mix;
+	for (const std::string &program : programs)
+	{
+		MemoryStorage mem;
+		CachedMemory cache(mem);
+		Cpu cpu {cache};
+		if (!mem.LoadElf(program))
+			continue;
+		cpu.Reset(0x200);
+
+		HostState host;
+		host.quiet = true;
+		for (size_t n = 0; n < maxPerProgram; n++)
+		{
+			mix.push_back(cache.Peek(cpu.GetIp()));
+			cpu.Step(false);
+			std::optional<CpuToHostData> msg = cpu.GetMessage();
+			if (msg && HandleMessage(*msg, host))
+				break;
+		}
+	}
+
+	if (mix.size() <= mixSize)
+		return mix;
+	std::vector<Word> sample;
+	for (size_t i = 0; i < mixSize; i++)
+		sample.push_back(mix[i * mix.size() / mixSize]);
+	return sample;
+}
+
+static void BenchDecoder(ComponentBench &bench, const std::vector<Word> &code)
+{
+	Decoder decoder;
+	bench.Run("decoder/mix", code.size(), [&] {
+		for (Word word : code)
+		{
+			InstructionPtr instr = decoder.Decode(word);
+			Consume(instr->_type);
+		}
+	});
+}
+
+static void BenchExecutor(ComponentBench &bench, const std::vector<Word> &code)
+{
+	static const char *typeNames[] = {"unsupported", "alu", "ld", "st", "j", "jr", "br", "csrr", "csrw", "auipc"};
+
+	Decoder decoder;
+	std::map<IType, std::vector<InstructionPtr>> byType;
+	for (size_t i = 0; i < code.size(); i++)
+	{
+		InstructionPtr instr = decoder.Decode(code[i]);
+		instr->_src1Val = 0x1000 + Word(i) * 4;
+		instr->_src2Val = Word(i);
+		instr->_csrVal = Word(i);
+		byType[instr->_type].push_back(std::move(instr));
+	}
+
+	Executor exe;
+	for (auto &[type, instrs] : byType)
+	{
+		if (type == IType::Unsupported)
+			continue;
+		bench.Run(std::string("executor/") + typeNames[size_t(type)], instrs.size(), [&] {
+			for (InstructionPtr &instr : instrs)
+			{
+				exe.Execute(instr, 0x200);
+				Consume(instr->_nextIp);
+			}
+		});
+	}
+}
+
+static void BenchRegisterFile(ComponentBench &bench, const std::vector<Word> &code)
+{
+	Decoder decoder;
+	std::vector<InstructionPtr> instrs;
+	for (Word word : code)
+		instrs.push_back(decoder.Decode(word));
+
+	RegisterFile rf;
+	bench.Run("register_file/read", instrs.size(), [&] {
+		for (InstructionPtr &instr : instrs)
+		{
+			rf.Read(instr);
+			Consume(instr->_src1Val);
+		}
+	});
+	bench.Run("register_file/write", instrs.size(), [&] {
+		for (InstructionPtr &instr : instrs)
+			rf.Write(instr);
+	});
+}
+
+static void BenchCache(ComponentBench &bench)
+{
+	static constexpr size_t accesses = 256;
+	// One line of each cache: every access to a new line misses
+	const CacheConfig tiny {line_size_bytes, line_size_bytes};
+
+	MemoryStorage mem;
+	CachedMemory hits(mem);
+	CachedMemory misses(mem, tiny);
+
+	auto fetch = [](CachedMemory &cache, Word ip) {
+		cache.Request(ip);
+		std::optional<Word> word;
+		while (!(word = cache.Response()))
+			cache.Clock();
+		Consume(*word);
+	};
+	bench.Run("cache/code_hit", accesses, [&] {
+		for (Word i = 0; i < accesses; i++)
+			fetch(hits, 0x200 + i % lineSizeWords * 4);
+	});
+	bench.Run("cache/code_miss", accesses, [&] {
+		for (Word i = 0; i < accesses; i++)
+			fetch(misses, i * line_size_bytes);
+	});
+
+	InstructionPtr instr(new Instruction());
+	auto access = [&instr](CachedMemory &cache, IType type, Word addr) {
+		instr->_type = type;
+		instr->_addr = addr;
+		instr->_data = addr;
+		cache.Request(instr);
+		while (!cache.Response(instr))
+			cache.Clock();
+		Consume(instr->_data);
+	};
+	bench.Run("cache/data_hit", accesses, [&] {
+		for (Word i = 0; i < accesses; i++)
+			access(hits, i % 2 ? IType::St : IType::Ld, 0x10000 + i % lineSizeWords * 4);
+	});
+	bench.Run("cache/data_miss_clean", accesses, [&] {
+		for (Word i = 0; i < accesses; i++)
+			access(misses, IType::Ld, 0x10000 + i * line_size_bytes);
+	});
+	bench.Run("cache/data_miss_dirty", accesses, [&] {
+		for (Word i = 0; i < accesses; i++)
+			access(misses, IType::St, 0x10000 + i * line_size_bytes);
+	});
+}
+
+static void BenchLoadElf(ComponentBench &bench, const std::vector<std::string> &programs)
+{
+	MemoryStorage mem;
+	for (const std::string &program : programs)
+	{
+		if (program.find("bigbenchmarks/bin/qsort.riscv") == std::string::npos)
+			continue;
+		bench.Run("memory/load_elf", 1, [&] {
+			Consume(mem.LoadElf(program));
+		});
+	}
+}
+
+static void PrintUsage(const char *argv0)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  --runs N           timed samples per benchmark (default: 9)\n"
+	        "  --programs DIR     directory of the program suites (default: programs/build)\n"
+	        "  --filter TEXT      only run benchmarks whose name contains TEXT\n"
+	        "  --save FILE        write the results as a baseline to FILE\n"
+	        "  --compare FILE     fail if a result is slower than in baseline FILE ...\n"
+	        "  --threshold PCT    ... by more than PCT percent (default: 10)\n",
+	        argv0);
+}
+
+static bool ParseOptions(int argc, char **argv, BenchOptions &opts)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool ok = value != nullptr;
+		if (arg == "--runs" && value)
+			ok = (opts.runs = atoi(value)) > 0;
+		else if (arg == "--programs" && value)
+			opts.programs = value;
+		else if (arg == "--filter" && value)
+			opts.filter = value;
+		else if (arg == "--save" && value)
+			opts.saveFile = value;
+		else if (arg == "--compare" && value)
+			opts.compareFile = value;
+		else if (arg == "--threshold" && value)
+			ok = (opts.threshold = atof(value)) > 0;
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			fprintf(stderr, "ERROR: bad argument \"%s\"\n", arg.c_str());
+			PrintUsage(argv[0]);
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions opts;
+	if (!ParseOptions(argc, argv, opts))
+		return 1;
+
+	std::vector<std::string> programs = ListPrograms(opts.programs);
+	std::vector<Word> code = CollectMix(programs);
+	if (code.empty())
+	{
+		fprintf(stderr, "ERROR: no programs found in \"%s\"\n", opts.programs.c_str());
+		return 1;
+	}
+
+	ComponentBench bench(opts);
+	BenchDecoder(bench, code);
+	BenchExecutor(bench, code);
+	BenchRegisterFile(bench, code);
+	BenchCache(bench);
+	BenchLoadElf(bench, programs);
+
+	if (!opts.saveFile.empty() && !SaveBaseline(opts.saveFile, bench.Results()))
+		return 1;
+	if (!opts.compareFile.empty() && !CompareBaseline(opts.compareFile, bench.Results(), opts.threshold))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,188 @@
+// End-to-end simulation throughput over the shipped program suites: every program is
+// loaded and run to exit in this process, --runs times, and its host wall time per run,
+// simulated MIPS and peak resident memory are reported. Programs shorter than
+// minSampleSeconds are run several times back to back per sample, so that the short
+// assembly tests can be compared against a baseline as well. Programs run through the
+// Simulator of libriscv_sim, as any in-process harness would
+
+#include "Bench.h"
+#include "Simulator.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct ThroughputOptions
+{
+	int runs = 3;
+	std::string programs = "programs/build";
+	std::string filter;
+	std::string saveFile;
+	std::string compareFile;
+	double threshold = 10;
+};
+
+static constexpr double minSampleSeconds = 0.01;
+
+struct RunResult
+{
+	double seconds = 0;
+	uint64_t instret = 0;
+	int exitCode = 0;
+};
+
+static RunResult RunProgram(const std::string &program)
+{
+	Simulator sim;
+	RunResult result;
+	if (!sim.LoadElf(program))
+	{
+		result.exitCode = -1;
+		return result;
+	}
+
+	sim.GetHost().quiet = true;
+	auto start = std::chrono::steady_clock::now();
+	sim.Run();
+	result.seconds = Seconds(start, std::chrono::steady_clock::now());
+	result.instret = sim.GetInstret();
+	result.exitCode = sim.GetHost().exitCode;
+	return result;
+}
+
+// Peak resident set since the last ResetPeakRss, in KB. Linux resets the VmHWM
+// high-water mark on writing 5 to clear_refs, which makes it per program; elsewhere
+// this is the peak of the whole process
+static void ResetPeakRss()
+{
+	std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+static long PeakRssKb()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return atol(line.c_str() + 6);
+	}
+	return 0;
+}
+
+static void PrintUsage(const char *argv0)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  --runs N           runs of each program (default: 3)\n"
+	        "  --programs DIR     directory of the program suites (default: programs/build)\n"
+	        "  --filter TEXT      only run programs whose path contains TEXT\n"
+	        "  --save FILE        write the best wall times as a baseline to FILE\n"
+	        "  --compare FILE     fail if a program is slower than in baseline FILE ...\n"
+	        "  --threshold PCT    ... by more than PCT percent (default: 10)\n",
+	        argv0);
+}
+
+static bool ParseOptions(int argc, char **argv, ThroughputOptions &opts)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool ok = value != nullptr;
+		if (arg == "--runs" && value)
+			ok = (opts.runs = atoi(value)) > 0;
+		else if (arg == "--programs" && value)
+			opts.programs = value;
+		else if (arg == "--filter" && value)
+			opts.filter = value;
+		else if (arg == "--save" && value)
+			opts.saveFile = value;
+		else if (arg == "--compare" && value)
+			opts.compareFile = value;
+		else if (arg == "--threshold" && value)
+			ok = (opts.threshold = atof(value)) > 0;
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			fprintf(stderr, "ERROR: bad argument \"%s\"\n", arg.c_str());
+			PrintUsage(argv[0]);
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	ThroughputOptions opts;
+	if (!ParseOptions(argc, argv, opts))
+		return 1;
+
+	std::vector<std::string> programs = ListPrograms(opts.programs);
+	if (programs.empty())
+	{
+		fprintf(stderr, "ERROR: no programs found in \"%s\"\n", opts.programs.c_str());
+		return 1;
+	}
+
+	printf("%-36s %10s %10s %10s %8s %10s\n", "program", "instret", "best ms", "median ms", "MIPS", "peak KB");
+	std::vector<BenchResult> results;
+	double totalSeconds = 0;
+	uint64_t totalInstret = 0;
+	bool ok = true;
+	for (const std::string &program : programs)
+	{
+		// Suite and program, e.g. bigbenchmarks/qsort
+		std::string name = program.substr(opts.programs.size() + 1);
+		name = name.substr(0, name.find('/')) + "/" + name.substr(name.rfind('/') + 1, name.size() - name.rfind('/') - 7);
+		if (!opts.filter.empty() && name.find(opts.filter) == std::string::npos)
+			continue;
+
+		ResetPeakRss();
+		RunResult run = RunProgram(program);
+		size_t repeats = std::max(size_t(1), size_t(minSampleSeconds / std::max(run.seconds, 1e-6)));
+		std::vector<double> samples;
+		for (int i = 0; i < opts.runs; i++)
+		{
+			double seconds = 0;
+			for (size_t r = 0; r < repeats; r++)
+			{
+				run = RunProgram(program);
+				seconds += run.seconds;
+			}
+			samples.push_back(seconds / repeats);
+		}
+		if (run.exitCode != 0)
+		{
+			fprintf(stderr, "ERROR: %s exited with %d\n", name.c_str(), run.exitCode);
+			ok = false;
+		}
+
+		BenchResult result = Summarize(name, samples);
+		printf("%-36s %10lu %10.2f %10.2f %8.2f %10ld\n", name.c_str(), (unsigned long) run.instret, 1e3 * result.best,
+		       1e3 * result.median, result.best ? run.instret / result.best / 1e6 : 0.0, PeakRssKb());
+		fflush(stdout);
+		results.push_back(result);
+		totalSeconds += result.best;
+		totalInstret += run.instret;
+	}
+	printf("%-36s %10lu %10.2f %10s %8.2f\n", "total", (unsigned long) totalInstret, 1e3 * totalSeconds, "",
+	       totalSeconds ? totalInstret / totalSeconds / 1e6 : 0.0);
+
+	// The sum is steadier than any single program, so it is gated as well
+	BenchResult total;
+	total.name = "total";
+	total.best = totalSeconds;
+	results.push_back(total);
+
+	if (!opts.saveFile.empty() && !SaveBaseline(opts.saveFile, results))
+		return 1;
+	if (!opts.compareFile.empty() && !CompareBaseline(opts.compareFile, results, opts.threshold))
+		return 1;
+	return ok ? 0 : 1;
+}
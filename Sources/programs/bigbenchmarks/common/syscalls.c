@@ -12,12 +12,27 @@
 void printInt(uint32_t c) {
 	printf("%d", c);
 }
+void printInt64(uint64_t c) {
+	printf("%llu", (unsigned long long)c);
+}
 void printChar(uint32_t c) {
 	printf("%c", (char)c);
 }
 void printStr(char *x) {
 	printf("%s", x);
 }
+void hostPrintStr(char *x) {
+	printf("%s", x);
+}
+void hostPrintArray(int n, const int arr[]) {
+	int i;
+	for (i = 0; i < n; i++)
+		printf(i ? " %d" : "%d", arr[i]);
+	printf("\n");
+}
+void hostDumpArray(uint32_t tag, int n, const int arr[]) {
+	// no simulator to collect result arrays
+}
 #else
 
 // tag of data to host
@@ -37,6 +52,33 @@ void printInt(uint32_t c) {
 	asm volatile ("csrw mtohost, %0" : : "r" (hi));
 }
 
+// printInt only carries 32 bits (printed signed by the simulator), so the digits
+// are sent as a string. They are found by repeated subtraction, as RV32I has no
+// divide and 64-bit division would need libgcc
+void printInt64(uint64_t c) {
+	static const uint64_t powers[] = {
+		10000000000000000000ull, 1000000000000000000ull, 100000000000000000ull,
+		10000000000000000ull, 1000000000000000ull, 100000000000000ull, 10000000000000ull,
+		1000000000000ull, 100000000000ull, 10000000000ull, 1000000000ull, 100000000ull,
+		10000000ull, 1000000ull, 100000ull, 10000ull, 1000ull, 100ull, 10ull
+	};
+	char buf[24];
+	int n = 0;
+	int i;
+	for (i = 0; i < (int)(sizeof(powers) / sizeof(powers[0])); i++) {
+		char digit = '0';
+		while (c >= powers[i]) {
+			c -= powers[i];
+			digit++;
+		}
+		if (digit != '0' || n > 0)
+			buf[n++] = digit;
+	}
+	buf[n++] = '0' + (char)c;
+	buf[n] = '\0';
+	printStr(buf);
+}
+
 void printChar(uint32_t c) {
 	c = (c & 0x0000FFFF) | (((uint32_t)PrintChar) << 16);
   asm volatile ("csrw mtohost, %0" : : "r" (c));
@@ -57,6 +99,76 @@ void printStr(char* x) {
   }
 }
 
+// host I/O device registers and buffer (see HostIoDevice.h in the simulator)
+#define HOSTIO_DOORBELL ((volatile uint32_t *) 0x40000000)
+#define HOSTIO_LENGTH   ((volatile uint32_t *) 0x40000004)
+#define HOSTIO_TAG      ((volatile uint32_t *) 0x40000008)
+#define HOSTIO_BUFFER   ((volatile uint32_t *) 0x40001000)
+#define HOSTIO_BUFFER_BYTES 0x10000
+
+// commands written to the doorbell
+enum HostIoCommand {
+	HostIoConsole = 1,
+	HostIoWords = 2,
+	HostIoArray = 3
+};
+
+static void hostIoRing(uint32_t cmd, uint32_t tag, uint32_t bytes) {
+	*HOSTIO_LENGTH = bytes;
+	*HOSTIO_TAG = tag;
+	*HOSTIO_DOORBELL = cmd;
+}
+
+void hostPrintStr(char *x) {
+  uint32_t n = 0;
+  uint32_t word = 0;
+  while(1) {
+     // same 4B aligned reads as printStr, packed 4 chars per buffer word
+     uint32_t* y = (uint32_t*)(((uint32_t)x) & ~0x03);
+     uint32_t shift = (((uint32_t)x) & 0x3) << 3;
+     uint32_t c = ((*y) >> shift) & 0x0FF;
+     if(c == (uint32_t)'\0')
+       break;
+     word |= c << ((n & 0x3) << 3);
+     n++;
+     if((n & 0x3) == 0) {
+       HOSTIO_BUFFER[(n >> 2) - 1] = word;
+       word = 0;
+     }
+     if(n == HOSTIO_BUFFER_BYTES) {
+       hostIoRing(HostIoConsole, 0, n);
+       n = 0;
+     }
+     x++;
+  }
+  if(n & 0x3)
+    HOSTIO_BUFFER[n >> 2] = word;
+  if(n > 0)
+    hostIoRing(HostIoConsole, 0, n);
+}
+
+// arrays larger than the buffer go out in pieces; the host appends the pieces of
+// an array and prints each piece of words as its own line
+static void hostSendWords(uint32_t cmd, uint32_t tag, int n, const int arr[]) {
+	while (n > 0) {
+		int chunk = n < HOSTIO_BUFFER_BYTES / 4 ? n : HOSTIO_BUFFER_BYTES / 4;
+		int i;
+		for (i = 0; i < chunk; i++)
+			HOSTIO_BUFFER[i] = arr[i];
+		hostIoRing(cmd, tag, chunk * 4);
+		arr += chunk;
+		n -= chunk;
+	}
+}
+
+void hostPrintArray(int n, const int arr[]) {
+	hostSendWords(HostIoWords, 0, n, arr);
+}
+
+void hostDumpArray(uint32_t tag, int n, const int arr[]) {
+	hostSendWords(HostIoArray, tag, n, arr);
+}
+
 void toHostExit(uint32_t ret) {
 	ret = (ret & 0x0000FFFF) | (((uint32_t) ExitCode) << 16);
 	asm volatile ("csrw mtohost, %0" : : "r" (ret));
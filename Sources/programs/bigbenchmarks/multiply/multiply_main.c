@@ -36,17 +36,17 @@ int main( int argc, char* argv[] )
 	printArray( "verify", DATA_SIZE, verify_data );
 #endif
 
-	uint32_t cycle = getCycle();
-	uint32_t insts = getInsts();
+	uint64_t cycle = getCycle64();
+	uint64_t insts = getInsts64();
 
 	for (i = 0; i < DATA_SIZE; i++) {
 		results_data[i] = multiply( input_data1[i], input_data2[i] );
 	}
 
-	cycle = getCycle() - cycle;
-	insts = getInsts() - insts;
-	printStr("Cycles = "); printInt(cycle); printChar('\n');
-	printStr("Insts  = "); printInt(insts); printChar('\n');
+	cycle = getCycle64() - cycle;
+	insts = getInsts64() - insts;
+	printStr("Cycles = "); printInt64(cycle); printChar('\n');
+	printStr("Insts  = "); printInt64(insts); printChar('\n');
   
 #if HOST_DEBUG
 	// Print out the results
@@ -271,15 +271,15 @@ int main( int argc, char* argv[] )
 	// Solve it
 	towers_clear( &towers );
 
-	uint32_t cycle = getCycle();
-	uint32_t insts = getInsts();
+	uint64_t cycle = getCycle64();
+	uint64_t insts = getInsts64();
 
 	towers_solve( &towers );
 
-	cycle = getCycle() - cycle;
-	insts = getInsts() - insts;
-	printStr("Cycles = "); printInt(cycle); printChar('\n');
-	printStr("Insts  = "); printInt(insts); printChar('\n');
+	cycle = getCycle64() - cycle;
+	insts = getInsts64() - insts;
+	printStr("Cycles = "); printInt64(cycle); printChar('\n');
+	printStr("Insts  = "); printInt64(insts); printChar('\n');
 
 #if HOST_DEBUG
 	// Print out the results
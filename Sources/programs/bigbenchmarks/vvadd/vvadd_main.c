@@ -47,15 +47,15 @@ int main( int argc, char* argv[] )
 #endif
 
 	// Do the vvadd
-	uint32_t cycle = getCycle();
-	uint32_t insts = getInsts();
+	uint64_t cycle = getCycle64();
+	uint64_t insts = getInsts64();
 
 	vvadd( DATA_SIZE, input1_data, input2_data, results_data );
 
-	cycle = getCycle() - cycle;
-	insts = getInsts() - insts;
-	printStr("Cycles = "); printInt(cycle); printChar('\n');
-	printStr("Insts  = "); printInt(insts); printChar('\n');
+	cycle = getCycle64() - cycle;
+	insts = getInsts64() - insts;
+	printStr("Cycles = "); printInt64(cycle); printChar('\n');
+	printStr("Insts  = "); printInt64(insts); printChar('\n');
 
 #if HOST_DEBUG
 	// Print out the results
@@ -28,6 +28,8 @@
 	}
 	static uint32_t getInsts() { return 0; }
 	static uint32_t getCycle() { return 0; }
+	static uint64_t getInsts64() { return 0; }
+	static uint64_t getCycle64() { return 0; }
 	static uint32_t getCoreId() { return 0; }
 
 #else // HOST_DEBUG = 0
@@ -44,6 +46,28 @@
 		return cyc_num;
 	}
 
+	// full 64-bit counters; the high half is read again in case the low half
+	// wrapped in between
+	static uint64_t getInsts64() {
+		uint32_t hi, lo, hi2;
+		do {
+			asm volatile ("csrr %0, instreth" : "=r"(hi) : );
+			asm volatile ("csrr %0, instret" : "=r"(lo) : );
+			asm volatile ("csrr %0, instreth" : "=r"(hi2) : );
+		} while (hi != hi2);
+		return ((uint64_t)hi << 32) | lo;
+	}
+
+	static uint64_t getCycle64() {
+		uint32_t hi, lo, hi2;
+		do {
+			asm volatile ("csrr %0, cycleh" : "=r"(hi) : );
+			asm volatile ("csrr %0, cycle" : "=r"(lo) : );
+			asm volatile ("csrr %0, cycleh" : "=r"(hi2) : );
+		} while (hi != hi2);
+		return ((uint64_t)hi << 32) | lo;
+	}
+
 	static uint32_t getCoreId() {
 		uint32_t id = 0;
 		asm volatile ("csrr %0, mhartid" : "=r"(id) : );
@@ -54,9 +78,18 @@
 
 
 void printInt(uint32_t c);
+// Prints the full value in decimal, e.g. a getCycle64() count past 2^32
+void printInt64(uint64_t c);
 void printChar(uint32_t c);
 void printStr(char *x);
 
+// Bulk transfers through the simulator's memory-mapped host I/O device: a whole
+// string or array per request instead of one mtohost write per character or int
+void hostPrintStr(char *x);
+void hostPrintArray(int n, const int arr[]);
+// Sends arr to the host as binary result array `tag` (riscv_sim --result-arrays)
+void hostDumpArray(uint32_t tag, int n, const int arr[]);
+
 static int verify(int n, const volatile int* test, const int* verify) {
   // correct: return 0
   // wrong: return wrong idx + 1
@@ -185,17 +185,17 @@ int main( int argc, char* argv[] )
 	printArray( "verify", DATA_SIZE, verify_data );
 #endif
 
-	uint32_t cycle = getCycle();
-	uint32_t insts = getInsts();
+	uint64_t cycle = getCycle64();
+	uint64_t insts = getInsts64();
 
 	// Do the sort
 	sort( DATA_SIZE, input_data );
     /* quick_sort(input_data, 0, DATA_SIZE-1); */
 
-	cycle = getCycle() - cycle;
-	insts = getInsts() - insts;
-	printStr("Cycles = "); printInt(cycle); printChar('\n');
-	printStr("Insts  = "); printInt(insts); printChar('\n');
+	cycle = getCycle64() - cycle;
+	insts = getInsts64() - insts;
+	printStr("Cycles = "); printInt64(cycle); printChar('\n');
+	printStr("Insts  = "); printInt64(insts); printChar('\n');
 
 #if HOST_DEBUG
 	// Print out the results
@@ -12,7 +12,22 @@ enum class CpuToHostType : uint16_t
     ExitCode = 0,
     PrintChar = 1,
     PrintIntLow = 2,
-    PrintIntHigh = 3
+    PrintIntHigh = 3,
+    // Data is a tag the host can stop at (see Marker), the message is otherwise ignored
+    Marker = 4,
+    // Data is the command written to the doorbell of the host I/O device (see HostIoDevice)
+    HostIo = 5,
+    // Raised by the simulator itself when it ends a run the guest did not, data is a HaltReason
+    Halt = 6
+};
+
+enum class HaltReason : uint16_t
+{
+    // A jump or branch to itself that leaves the registers unchanged, which nothing can
+    // ever leave again
+    IdleLoop = 1,
+    // The cycle or host time limit ran out
+    Watchdog = 2
 };
 
 union CpuToHostData
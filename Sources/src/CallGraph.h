@@ -0,0 +1,135 @@
+#ifndef RISCV_SIM_CALLGRAPH_H
+#define RISCV_SIM_CALLGRAPH_H
+
+#include "Instruction.h"
+#include "SymbolTable.h"
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Attributes cycles to the guest call stack, tracked from the instruction stream alone:
+// jal/jalr writing ra is a call, jalr x0, 0(ra) is a return. The stacks seen are kept
+// as a call tree and written in the folded format of flame graph tools
+class CallGraphProfiler
+{
+public:
+	void Start(Word ip, uint64_t cycle)
+	{
+		_nodes.assign(1, Node {noParent, ip, 0, 0});
+		_children.clear();
+		_current = 0;
+		_depth = 0;
+		_overflow = 0;
+		_lastCycle = cycle;
+	}
+
+	void Retire(const Instruction &instr, Word ip, uint64_t cycle)
+	{
+		_nodes[_current].cycles += cycle - _lastCycle;
+		_lastCycle = cycle;
+
+		if (instr._type == IType::J || instr._type == IType::Jr)
+		{
+			if (instr._dst.value_or(0) == ra)
+				Call(instr._nextIp, ip + 4);
+			else if (instr._type == IType::Jr && !instr._dst && instr._src1.value_or(0) == ra)
+				Return(instr._nextIp);
+		}
+	}
+
+	// One "outer;...;inner cycles" line per distinct stack with cycles of its own
+	bool Write(const std::string &filename, const SymbolTable &symbols) const
+	{
+		FILE *out = fopen(filename.c_str(), "w");
+		if (out == nullptr)
+		{
+			fprintf(stderr, "ERROR: failed opening call graph file \"%s\"\n", filename.c_str());
+			return false;
+		}
+
+		std::vector<std::string> names(_nodes.size());
+		for (size_t i = 0; i < _nodes.size(); i++)
+		{
+			const Node &node = _nodes[i];
+			// Parents are always created before their children
+			std::string name = symbols.Describe(node.addr);
+			names[i] = node.parent == noParent ? name : names[node.parent] + ";" + name;
+			if (node.cycles != 0)
+				fprintf(out, "%s %lu\n", names[i].c_str(), (unsigned long) node.cycles);
+		}
+		return fclose(out) == 0;
+	}
+
+private:
+	static constexpr RId ra = 1;
+	static constexpr uint32_t noParent = ~0u;
+	// Deeper calls are charged to the deepest frame rather than growing the tree further
+	static constexpr size_t maxDepth = 512;
+
+	struct Node
+	{
+		uint32_t parent;
+		Word addr;
+		// Where the call that created this frame returns to
+		Word returnIp;
+		uint64_t cycles;
+	};
+
+	void Call(Word target, Word returnIp)
+	{
+		if (_depth >= maxDepth)
+		{
+			_overflow++;
+			return;
+		}
+
+		uint64_t key = uint64_t(_current) << 32u | target;
+		auto child = _children.find(key);
+		if (child == _children.end())
+		{
+			_nodes.push_back(Node {_current, target, returnIp, 0});
+			child = _children.emplace(key, uint32_t(_nodes.size() - 1)).first;
+		}
+		_current = child->second;
+		_nodes[_current].returnIp = returnIp;
+		_depth++;
+	}
+
+	// Unwinds to the frame whose call returns to `target`, so returns that skip frames
+	// still leave the right stack; a return matching no frame is ignored. Returns of
+	// calls dropped past maxDepth come first: in a deep recursion their return address
+	// also matches the recorded frames, which must not be popped early
+	void Return(Word target)
+	{
+		if (_overflow > 0)
+		{
+			_overflow--;
+			return;
+		}
+
+		uint32_t frame = _current;
+		size_t depth = _depth;
+		while (frame != 0 && _nodes[frame].returnIp != target)
+		{
+			frame = _nodes[frame].parent;
+			depth--;
+		}
+		if (frame == 0)
+			return;
+
+		_current = _nodes[frame].parent;
+		_depth = depth - 1;
+	}
+
+	std::vector<Node> _nodes;
+	std::unordered_map<uint64_t, uint32_t> _children;
+	uint32_t _current = 0;
+	size_t _depth = 0;
+	// Calls past maxDepth whose returns are still to come
+	size_t _overflow = 0;
+	uint64_t _lastCycle = 0;
+};
+
+#endif //RISCV_SIM_CALLGRAPH_H
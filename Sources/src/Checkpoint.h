@@ -0,0 +1,147 @@
+
+#ifndef RISCV_SIM_CHECKPOINT_H
+#define RISCV_SIM_CHECKPOINT_H
+
+#include <string>
+#include <cstdint>
+#include <map>
+#include <type_traits>
+#include <zlib.h>
+
+// Checkpoints are a gzip stream of the raw state of every component, written and
+// read back in the same order. Only trivially copyable values go through Put/Get,
+// containers are written as their size followed by their elements.
+static constexpr uint32_t checkpointMagic = 0x4b435652; // "RVCK"
+static constexpr uint32_t checkpointVersion = 8;
+// Guest memory is stored in pages of this size, all-zero pages are left out
+static constexpr size_t checkpointPageBytes = 4096;
+static constexpr uint32_t checkpointEndOfPages = 0xffffffff;
+
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(const std::string &filename)
+    {
+        // Fastest level: restore time matters more than file size
+        _file = gzopen(filename.c_str(), "wb1");
+        _ok = _file != nullptr;
+    }
+
+    ~CheckpointWriter()
+    {
+        Close();
+    }
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    void Write(const void *data, size_t size)
+    {
+        if (_ok && gzwrite(_file, data, unsigned(size)) != int(size))
+            _ok = false;
+    }
+
+    template<typename T>
+    void Put(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "only raw values can be checkpointed");
+        Write(&value, sizeof(T));
+    }
+
+    template<typename K, typename V>
+    void PutMap(const std::map<K, V> &map)
+    {
+        Put(map.size());
+        for (auto &[key, value] : map)
+        {
+            Put(key);
+            Put(value);
+        }
+    }
+
+    bool Close()
+    {
+        if (_file != nullptr)
+        {
+            if (gzclose(_file) != Z_OK)
+                _ok = false;
+            _file = nullptr;
+        }
+        return _ok;
+    }
+
+    bool Ok() const
+    {
+        return _ok;
+    }
+
+private:
+    gzFile _file = nullptr;
+    bool _ok = false;
+};
+
+class CheckpointReader
+{
+public:
+    explicit CheckpointReader(const std::string &filename)
+    {
+        _file = gzopen(filename.c_str(), "rb");
+        _ok = _file != nullptr;
+        if (_ok)
+            gzbuffer(_file, 128 * 1024);
+    }
+
+    ~CheckpointReader()
+    {
+        if (_file != nullptr)
+            gzclose(_file);
+    }
+
+    CheckpointReader(const CheckpointReader &) = delete;
+
+    CheckpointReader &operator=(const CheckpointReader &) = delete;
+
+    void Read(void *data, size_t size)
+    {
+        if (_ok && gzread(_file, data, unsigned(size)) != int(size))
+            _ok = false;
+    }
+
+    template<typename T>
+    void Get(T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "only raw values can be checkpointed");
+        Read(&value, sizeof(T));
+    }
+
+    template<typename T>
+    T Get()
+    {
+        T value{};
+        Get(value);
+        return value;
+    }
+
+    template<typename K, typename V>
+    void GetMap(std::map<K, V> &map)
+    {
+        map.clear();
+        for (size_t n = Get<size_t>(); n > 0 && _ok; n--)
+        {
+            K key = Get<K>();
+            map[key] = Get<V>();
+        }
+    }
+
+    bool Ok() const
+    {
+        return _ok;
+    }
+
+private:
+    gzFile _file = nullptr;
+    bool _ok = false;
+};
+
+#endif //RISCV_SIM_CHECKPOINT_H
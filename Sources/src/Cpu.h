@@ -7,48 +7,87 @@
 #include "CsrFile.h"
 #include "Executor.h"
 #include "Memory/CachedMemory.h"
+#include "Memory/UncachedMemory.h"
+#include "Stats.h"
+#include "Instrumentation.h"
+#include "Profiler.h"
+#include "CallGraph.h"
+#include "Trace.h"
+#include "HostProfiler.h"
 
-class Cpu
+// The CPU is compiled once per memory model, so that every call into the model is a
+// direct, inlinable one; main picks the instantiation at run time (see --memory).
+// Memory is CachedMemory, UncachedMemory or a model with the same interface
+template<typename Memory>
+class BasicCpu
 {
 public:
-	Cpu(CachedMemory &mem)
+	explicit BasicCpu(Memory &mem)
 			: _mem(mem)
 	{
 		_status = Status::Ready;
+		_csrf.SetMessageFlag(&_messagePending);
+		_mem.GetHostIo().SetMessageFlag(&_messagePending);
 	}
 
+	~BasicCpu()
+	{
+		_mem.GetHostIo().SetMessageFlag(nullptr);
+	}
+
+	BasicCpu(const BasicCpu &) = delete;
+
+	BasicCpu &operator=(const BasicCpu &) = delete;
+
 	void Ready()
 	{
 		_mem.Request(_ip);
+		_host.Lap(HostProfiler::Memory);
 	}
 
 	bool Fetching()
 	{
 		_instruction_data = _mem.Response();
+		_host.Lap(HostProfiler::Memory);
 		if (_instruction_data == std::optional<Word>())
 		{
 			_status = Status::Load;
+			if constexpr (instrumented)
+				_stats.fetchStallCycles++;
 			return true;
 		}
 		_instruction = _decoder.Decode(*_instruction_data);
+		_host.Lap(HostProfiler::Decode);
 		_rf.Read(_instruction);
+		_host.Lap(HostProfiler::RegisterFile);
 		_csrf.Read(_instruction);
+		_host.Lap(HostProfiler::Csr);
 		_exe.Execute(_instruction, _ip);
+		_host.Lap(HostProfiler::Execute);
 		_mem.Request(_instruction);
+		_host.Lap(HostProfiler::Memory);
 
 		return false;
 	}
 
 	bool Executing()
 	{
-		if (!_mem.Response(_instruction))
+		bool done = _mem.Response(_instruction);
+		_host.Lap(HostProfiler::Memory);
+		if (!done)
 		{
 			_status = Status::Process;
+			if constexpr (instrumented)
+				_stats.memStallCycles++;
 			return true;
 		}
+		CheckIdleLoop();
 		_rf.Write(_instruction);
+		_host.Lap(HostProfiler::RegisterFile);
 		_csrf.Write(_instruction);
 		_csrf.InstructionExecuted();
+		_host.Lap(HostProfiler::Csr);
+		Retired();
 		_ip = _instruction->_nextIp;
 		_status = Status::Ready;
 
@@ -57,7 +96,10 @@ public:
 
 	void Clock()
 	{
+		if (_host.BeginCycle(_csrf.GetInstret(), _csrf.GetCycle()))
+			Halt(HaltReason::Watchdog);
 		_csrf.Clock();
+		_host.Lap(HostProfiler::Csr);
 
 		if (_status == Status::Ready)
 		{
@@ -68,31 +110,227 @@ public:
 		{
 			if (Fetching())
 			{
+				_host.EndCycle();
 				return;
 			}
 		}
 
 		Executing();
+		_host.EndCycle();
+	}
+
+	// Executes one whole instruction without timing: memory accesses complete at once
+	// and the cycle counter advances by one. Only valid at an instruction boundary
+	void Step(bool warm)
+	{
+		if (_host.BeginCycle(_csrf.GetInstret(), _csrf.GetCycle()))
+			Halt(HaltReason::Watchdog);
+		_csrf.Clock();
+		_host.Lap(HostProfiler::Csr);
+		_instruction_data = _mem.FetchFunctional(_ip, warm);
+		_host.Lap(HostProfiler::Memory);
+		_instruction = _decoder.Decode(*_instruction_data);
+		_host.Lap(HostProfiler::Decode);
+		_rf.Read(_instruction);
+		_host.Lap(HostProfiler::RegisterFile);
+		_csrf.Read(_instruction);
+		_host.Lap(HostProfiler::Csr);
+		_exe.Execute(_instruction, _ip);
+		_host.Lap(HostProfiler::Execute);
+		_mem.AccessFunctional(_instruction, warm);
+		_host.Lap(HostProfiler::Memory);
+		CheckIdleLoop();
+		_rf.Write(_instruction);
+		_host.Lap(HostProfiler::RegisterFile);
+		_csrf.Write(_instruction);
+		_csrf.InstructionExecuted();
+		_host.Lap(HostProfiler::Csr);
+		Retired();
+		_ip = _instruction->_nextIp;
+		_host.EndCycle();
+	}
+
+	// True if the instruction at _ip is a read of the cycle CSR (csrr rd, cycle), which
+	// is how the benchmarks open their timed region
+	bool NextReadsCycle() const
+	{
+		return (_mem.Peek(_ip) & csrrMask) == csrrCycle;
 	}
 
 	void Reset(Word ip)
 	{
 		_csrf.Reset();
 		_ip = ip;
+		_lastRetireCycle = 0;
 	}
 
+	void SetProfiler(Profiler *profiler)
+	{
+		_profiler = profiler;
+		if (_profiler != nullptr)
+			_profiler->Start(_csrf.GetCycle(), _mem.GetStats());
+	}
+
+	void SetCallGraphProfiler(CallGraphProfiler *callGraph)
+	{
+		_callGraph = callGraph;
+		if (_callGraph != nullptr)
+			_callGraph->Start(_ip, _csrf.GetCycle());
+	}
+
+	HostProfiler &GetHostProfiler()
+	{
+		return _host;
+	}
+
+	void SetTrace(TraceWriter *trace)
+	{
+		_trace = trace;
+	}
+
+	void RegisterStats(StatsRegistry &stats)
+	{
+		static const char *typeNames[numITypes] = {
+				"Unsupported", "Alu", "Ld", "St", "J", "Jr", "Br", "Csrr", "Csrw", "Auipc"};
+
+		_csrf.RegisterStats(stats);
+		if constexpr (instrumented)
+		{
+			_exe.RegisterStats(stats);
+			stats.AddCounter("cpu.fetch_stall_cycles", _stats.fetchStallCycles);
+			stats.AddCounter("cpu.mem_stall_cycles", _stats.memStallCycles);
+			stats.AddHistogram("cpu.itype", _stats.typeCounts.data(),
+			                   std::vector<std::string>(typeNames, typeNames + numITypes));
+			stats.AddHistogram("cpu.instr_cycles", _stats.instrCycles.data(),
+			                   StatsRegistry::Log2Labels(instrCyclesBuckets));
+		}
+		stats.AddFormula("cpu.cpi", [this] { return StatsRegistry::Ratio(GetCycle(), GetInstret()); });
+	}
+
+	// A mtohost write (or a CpuToHostType::Halt message, see Halt), or else a doorbell
+	// write to the host I/O device
 	std::optional<CpuToHostData> GetMessage()
 	{
-		return _csrf.GetMessage();
+		std::optional<CpuToHostData> msg = _csrf.GetMessage();
+		if (msg)
+			return msg;
+		// The device may still hold one behind a mtohost message, so the flag is only
+		// cleared once both are empty
+		_messagePending = false;
+		return _mem.GetHostIo().GetMessage();
+	}
+
+	// False unless GetMessage may have something, so that run loops can skip polling it
+	bool MessagePending() const
+	{
+		return _messagePending;
+	}
+
+	uint64_t GetInstret() const
+	{
+		return _csrf.GetInstret();
+	}
+
+	uint64_t GetCycle() const
+	{
+		return _csrf.GetCycle();
+	}
+
+	Word GetIp() const
+	{
+		return _ip;
+	}
+
+	// True between two instructions, when no fetch or memory access is in flight
+	// and the whole architectural state is in _ip, _rf and _csrf
+	bool AtInstructionBoundary() const
+	{
+		return _status == Status::Ready;
+	}
+
+	void Save(CheckpointWriter &cp) const
+	{
+		cp.Put(_ip);
+		_rf.Save(cp);
+		_csrf.Save(cp);
+		cp.Put(_stats);
+		cp.Put(_lastRetireCycle);
+		_exe.Save(cp);
+	}
+
+	void Restore(CheckpointReader &cp)
+	{
+		cp.Get(_ip);
+		_rf.Restore(cp);
+		_csrf.Restore(cp);
+		cp.Get(_stats);
+		cp.Get(_lastRetireCycle);
+		_exe.Restore(cp);
+		_status = Status::Ready;
 	}
 
 private:
+	// Only jumps and branches can have themselves as the next instruction, and they
+	// touch nothing but their destination register; if that already holds the value
+	// being written, the guest is stuck for good
+	void CheckIdleLoop()
+	{
+		if (_instruction->_nextIp == _ip && !_rf.Changes(_instruction))
+			Halt(HaltReason::IdleLoop);
+	}
+
+	// Ends the run through the same path as a guest message, so that the run loops
+	// need not poll anything else every cycle
+	void Halt(HaltReason reason)
+	{
+		CpuToHostData msg {};
+		msg.unpacked.data = uint16_t(reason);
+		msg.unpacked.type = CpuToHostType::Halt;
+		_csrf.PostMessage(msg);
+	}
+
+	void Retired()
+	{
+		if (_profiler != nullptr)
+			_profiler->Retire(_ip, _csrf.GetCycle(), _mem.GetStats());
+		if (_callGraph != nullptr)
+			_callGraph->Retire(*_instruction, _ip, _csrf.GetCycle());
+		if (_trace != nullptr)
+			_trace->Retire(_ip, *_instruction_data, *_instruction);
+
+		if constexpr (instrumented)
+		{
+			uint64_t cycle = _csrf.GetCycle();
+			_stats.typeCounts[size_t(_instruction->_type)]++;
+			_stats.instrCycles[StatsRegistry::Log2Bucket(cycle - _lastRetireCycle, instrCyclesBuckets)]++;
+			_lastRetireCycle = cycle;
+		}
+	}
+
+	static constexpr size_t numITypes = size_t(IType::Auipc) + 1;
+	static constexpr size_t instrCyclesBuckets = 10;
+
+	struct Stats
+	{
+		uint64_t fetchStallCycles = 0;
+		uint64_t memStallCycles = 0;
+		std::array<uint64_t, numITypes> typeCounts {};
+		// Cycles between two retirements, in power-of-two buckets
+		std::array<uint64_t, instrCyclesBuckets> instrCycles {};
+	};
+
+	// CSRRS with rs1 = x0 and any rd
+	static constexpr Word csrrMask = 0xfffff07f;
+	static constexpr Word csrrCycle = (Word(CsrIdx::Cycle) << 20u) | (fnCSRRS << 12u) | Word(Opcode::System);
+
 	Reg32 _ip;
 	Decoder _decoder;
 	RegisterFile _rf;
 	CsrFile _csrf;
 	Executor _exe;
-	CachedMemory &_mem;
+	Memory &_mem;
+	// Raised by _csrf and the host I/O device, see MessagePending
+	bool _messagePending = false;
 
 	InstructionPtr _instruction;
 	std::optional<Word> _instruction_data;
@@ -103,6 +341,16 @@ private:
 		Process
 	};
 	Status _status;
+
+	Stats _stats;
+	uint64_t _lastRetireCycle = 0;
+	Profiler *_profiler = nullptr;
+	CallGraphProfiler *_callGraph = nullptr;
+	TraceWriter *_trace = nullptr;
+	HostProfiler _host;
 };
 
+using Cpu = BasicCpu<CachedMemory>;
+using UncachedCpu = BasicCpu<UncachedMemory>;
+
 #endif //RISCV_SIM_CPU_H
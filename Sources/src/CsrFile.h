@@ -4,6 +4,8 @@
 
 #include <optional>
 #include "Instruction.h"
+#include "Checkpoint.h"
+#include "Stats.h"
 
 class CsrFile
 {
@@ -23,8 +25,14 @@ public:
 
         switch (static_cast<CsrIdx>(instr->_csr.value()))
         {
-            case CsrIdx::Instret: instr->_csrVal = numInstr; break;
-            case CsrIdx::Cycle  : instr->_csrVal = numCycles; break;
+            case CsrIdx::Instret:
+            case CsrIdx::Minstret: instr->_csrVal = Word(numInstr); break;
+            case CsrIdx::Cycle  :
+            case CsrIdx::Mcycle : instr->_csrVal = Word(numCycles); break;
+            case CsrIdx::InstretH:
+            case CsrIdx::MinstretH: instr->_csrVal = Word(numInstr >> 32u); break;
+            case CsrIdx::CycleH :
+            case CsrIdx::McycleH: instr->_csrVal = Word(numCycles >> 32u); break;
             case CsrIdx::Mhartid: instr->_csrVal = coreId; break;
             default: break;
         }
@@ -34,6 +42,7 @@ public:
         if (instr->_type == IType::Csrw && instr->_csr.value_or(CsrIdx::None) == CsrIdx::Mtohost)
         {
             cpuToHostData = CpuToHostData{instr->_data};
+            RaiseMessageFlag();
         }
     }
 
@@ -47,6 +56,21 @@ public:
         numCycles++;
     }
 
+    // Raises a message on behalf of the simulator, unless one from the guest is pending
+    void PostMessage(CpuToHostData msg)
+    {
+        if (!cpuToHostData)
+            cpuToHostData = msg;
+        RaiseMessageFlag();
+    }
+
+    // Set whenever a message is raised, for run loops to test before polling GetMessage;
+    // only whoever polls clears it
+    void SetMessageFlag(bool *flag)
+    {
+        messageFlag = flag;
+    }
+
     std::optional<CpuToHostData> GetMessage()
     {
         std::optional<CpuToHostData> ret;
@@ -54,12 +78,63 @@ public:
         return ret;
     }
 
+    uint64_t GetInstret() const
+    {
+        return numInstr;
+    }
+
+    uint64_t GetCycle() const
+    {
+        return numCycles;
+    }
+
+    void RegisterStats(StatsRegistry &stats)
+    {
+        stats.AddCounter("csr.cycle", numCycles);
+        stats.AddCounter("csr.instret", numInstr);
+    }
+
+    void Save(CheckpointWriter &cp) const
+    {
+        cp.Put(numInstr);
+        cp.Put(numCycles);
+        cp.Put(coreId);
+        cp.Put(cpuToHostData.has_value());
+        cp.Put(cpuToHostData.value_or(CpuToHostData{0}).payload);
+        cp.Put(startReg);
+    }
+
+    void Restore(CheckpointReader &cp)
+    {
+        cp.Get(numInstr);
+        cp.Get(numCycles);
+        cp.Get(coreId);
+        bool hasMessage = cp.Get<bool>();
+        Word payload = cp.Get<Word>();
+        if (hasMessage)
+        {
+            cpuToHostData = CpuToHostData{payload};
+            RaiseMessageFlag();
+        }
+        else
+            cpuToHostData.reset();
+        cp.Get(startReg);
+    }
+
 private:
-    Word numInstr = 0;
-    Word numCycles = 0;
+    void RaiseMessageFlag()
+    {
+        if (messageFlag != nullptr)
+            *messageFlag = true;
+    }
+
+    // Guests see the low and high halves through separate CSRs (cycle and cycleh, ...)
+    uint64_t numInstr = 0;
+    uint64_t numCycles = 0;
     Word coreId = 0;
     std::optional<CpuToHostData> cpuToHostData;
     bool startReg = false;
+    bool *messageFlag = nullptr;
 
 };
 
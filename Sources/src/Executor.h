@@ -3,6 +3,9 @@
 #define RISCV_SIM_EXECUTOR_H
 
 #include "Instruction.h"
+#include "Instrumentation.h"
+#include "Checkpoint.h"
+#include "Stats.h"
 
 class Executor
 {
@@ -67,9 +70,46 @@ public:
             }
         }
 
+        if constexpr (instrumented)
+        {
+            if (instr->_type == IType::Br)
+            {
+                _stats.branches++;
+                _stats.takenBranches += instr->_nextIp != ip + 4;
+            }
+            else if (instr->_type == IType::J || instr->_type == IType::Jr)
+            {
+                _stats.jumps++;
+            }
+        }
+    }
+
+    void RegisterStats(StatsRegistry &stats)
+    {
+        stats.AddCounter("exe.branches", _stats.branches);
+        stats.AddCounter("exe.taken_branches", _stats.takenBranches);
+        stats.AddCounter("exe.jumps", _stats.jumps);
+    }
+
+    void Save(CheckpointWriter &cp) const
+    {
+        cp.Put(_stats);
+    }
+
+    void Restore(CheckpointReader &cp)
+    {
+        cp.Get(_stats);
     }
 
 private:
+    struct Stats
+    {
+        uint64_t branches = 0;
+        uint64_t takenBranches = 0;
+        uint64_t jumps = 0;
+    };
+    Stats _stats;
+
     // Add helper functions here
 
     Word perform_alu(InstructionPtr& instr) {
@@ -0,0 +1,631 @@
+#ifndef RISCV_SIM_GENERATOR_H
+#define RISCV_SIM_GENERATOR_H
+
+#include "BaseTypes.h"
+#include "Instruction.h"
+#include "Memory/MemoryConfig.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Builds RV32I programs in memory, restricted to what Decoder supports (word loads and
+// stores only, no M extension). Branch and jump targets are labels, resolved in Finish.
+// A branch back to a label further than a B-type offset reaches becomes the inverted
+// branch over a jal; forward branches must stay within reach
+class ProgramBuilder
+{
+public:
+	using Label = size_t;
+
+	enum Reg : uint8_t
+	{
+		zero = 0, ra = 1, sp = 2, t0 = 5, t1 = 6, t2 = 7, s0 = 8, s1 = 9,
+		a0 = 10, a1 = 11, a2 = 12, s2 = 18
+	};
+
+	Label NewLabel()
+	{
+		_labels.push_back(unbound);
+		return _labels.size() - 1;
+	}
+
+	void Bind(Label label)
+	{
+		_labels[label] = _code.size();
+	}
+
+	void Lui(Reg rd, Word imm20)
+	{
+		Emit((imm20 << 12u) | (rd << 7u) | Word(Opcode::Lui));
+	}
+
+	// Any 32-bit constant in one or two instructions
+	void Li(Reg rd, Word value)
+	{
+		int32_t lo = SignExtend12(value);
+		if (Word(lo) == value)
+		{
+			Addi(rd, zero, lo);
+			return;
+		}
+		Lui(rd, (value - Word(lo)) >> 12u);
+		if (lo != 0)
+			Addi(rd, rd, lo);
+	}
+
+	void Addi(Reg rd, Reg rs1, int32_t imm) { I(Opcode::OpImm, AluFunc::Add, rd, rs1, imm); }
+	void Xori(Reg rd, Reg rs1, int32_t imm) { I(Opcode::OpImm, AluFunc::Xor, rd, rs1, imm); }
+	void Andi(Reg rd, Reg rs1, int32_t imm) { I(Opcode::OpImm, AluFunc::And, rd, rs1, imm); }
+	void Slli(Reg rd, Reg rs1, Word shamt) { I(Opcode::OpImm, AluFunc::Sll, rd, rs1, int32_t(shamt)); }
+	void Srli(Reg rd, Reg rs1, Word shamt) { I(Opcode::OpImm, AluFunc::Sr, rd, rs1, int32_t(shamt)); }
+	void Add(Reg rd, Reg rs1, Reg rs2) { R(AluFunc::Add, 0, rd, rs1, rs2); }
+	void Xor(Reg rd, Reg rs1, Reg rs2) { R(AluFunc::Xor, 0, rd, rs1, rs2); }
+
+	void Lw(Reg rd, Reg rs1, int32_t imm)
+	{
+		Emit((Word(imm) << 20u) | (rs1 << 15u) | (fnLW << 12u) | (rd << 7u) | Word(Opcode::Load));
+	}
+
+	void Sw(Reg rs2, Reg rs1, int32_t imm)
+	{
+		Emit(((Word(imm) >> 5u & 0x7fu) << 25u) | (rs2 << 20u) | (rs1 << 15u) | (fnSW << 12u)
+		     | ((Word(imm) & 0x1fu) << 7u) | Word(Opcode::Store));
+	}
+
+	void Bne(Reg rs1, Reg rs2, Label target) { Branch(BrFunc::Neq, rs1, rs2, target); }
+	void Bltu(Reg rs1, Reg rs2, Label target) { Branch(BrFunc::Ltu, rs1, rs2, target); }
+
+	void Jal(Reg rd, Label target)
+	{
+		_fixups.push_back({_code.size(), target, false});
+		Emit((rd << 7u) | Word(Opcode::Jal));
+	}
+
+	void Ret()
+	{
+		Emit((Word(ra) << 15u) | Word(Opcode::Jalr));
+	}
+
+	void Csrw(CsrIdx csr, Reg rs1)
+	{
+		Emit((Word(csr) << 20u) | (rs1 << 15u) | (fnCSRRW << 12u) | Word(Opcode::System));
+	}
+
+	// Exits with status 0 if `result` holds `expected`, 1 otherwise; both ends spin in a
+	// jump to itself after the exit message like toHostExit does
+	void CheckAndExit(Reg result, Word expected)
+	{
+		Label fail = NewLabel();
+		Li(t1, expected);
+		Bne(result, t1, fail);
+		Exit(0);
+		Bind(fail);
+		Exit(1);
+	}
+
+	void Exit(uint16_t code)
+	{
+		Li(t0, (Word(CpuToHostType::ExitCode) << 16u) | code);
+		Csrw(CsrIdx::Mtohost, t0);
+		Label self = NewLabel();
+		Bind(self);
+		Jal(zero, self);
+	}
+
+	// Resolves all label references; false if some label was never bound or is out of
+	// reach of its branch or jump
+	bool Finish(std::vector<Word> &code)
+	{
+		for (const Fixup &fixup : _fixups)
+		{
+			if (_labels[fixup.label] == unbound)
+				return false;
+			int64_t offset = Distance(fixup.at, fixup.label);
+			if (fixup.branch ? !InBranchReach(offset) : offset < -jumpReach || offset >= jumpReach)
+				return false;
+			_code[fixup.at] |= fixup.branch ? BranchOffset(Word(offset)) : JumpOffset(Word(offset));
+		}
+		code = _code;
+		return true;
+	}
+
+private:
+	static constexpr size_t unbound = ~size_t(0);
+	// Byte offsets of B-type branches are in [-branchReach, branchReach), those of jal in
+	// [-jumpReach, jumpReach)
+	static constexpr int64_t branchReach = 4096;
+	static constexpr int64_t jumpReach = 1024 * 1024;
+
+	struct Fixup
+	{
+		size_t at;
+		Label label;
+		bool branch;
+	};
+
+	int64_t Distance(size_t at, Label target) const
+	{
+		return (int64_t(_labels[target]) - int64_t(at)) * int64_t(sizeof(Word));
+	}
+
+	static bool InBranchReach(int64_t offset)
+	{
+		return offset >= -branchReach && offset < branchReach;
+	}
+
+	static BrFunc Inverted(BrFunc func)
+	{
+		switch (func)
+		{
+			case BrFunc::Eq: return BrFunc::Neq;
+			case BrFunc::Neq: return BrFunc::Eq;
+			case BrFunc::Lt: return BrFunc::Ge;
+			case BrFunc::Ge: return BrFunc::Lt;
+			case BrFunc::Ltu: return BrFunc::Geu;
+			default: return BrFunc::Ltu;
+		}
+	}
+
+	static int32_t SignExtend12(Word value)
+	{
+		return int32_t(value << 20u) >> 20;
+	}
+
+	static Word BranchOffset(Word imm)
+	{
+		return ((imm >> 12u & 1u) << 31u) | ((imm >> 5u & 0x3fu) << 25u) | ((imm >> 1u & 0xfu) << 8u)
+		       | ((imm >> 11u & 1u) << 7u);
+	}
+
+	static Word JumpOffset(Word imm)
+	{
+		return ((imm >> 20u & 1u) << 31u) | ((imm >> 1u & 0x3ffu) << 21u) | ((imm >> 11u & 1u) << 20u)
+		       | ((imm >> 12u & 0xffu) << 12u);
+	}
+
+	void Emit(Word instr)
+	{
+		_code.push_back(instr);
+	}
+
+	void I(Opcode opcode, AluFunc func, Reg rd, Reg rs1, int32_t imm)
+	{
+		Word funct3 = func == AluFunc::Sra || func == AluFunc::Srl ? Word(AluFunc::Sr) : Word(func);
+		Emit(((Word(imm) & 0xfffu) << 20u) | (rs1 << 15u) | (funct3 << 12u) | (rd << 7u) | Word(opcode));
+	}
+
+	void R(AluFunc func, Word funct7, Reg rd, Reg rs1, Reg rs2)
+	{
+		Emit((funct7 << 25u) | (rs2 << 20u) | (rs1 << 15u) | (Word(func) << 12u) | (rd << 7u)
+		     | Word(Opcode::Op));
+	}
+
+	void Branch(BrFunc func, Reg rs1, Reg rs2, Label target)
+	{
+		if (_labels[target] != unbound && !InBranchReach(Distance(_code.size(), target)))
+		{
+			// Skip the jal when the branch would not be taken
+			Label skip = NewLabel();
+			Branch(Inverted(func), rs1, rs2, skip);
+			Jal(zero, target);
+			Bind(skip);
+			return;
+		}
+		_fixups.push_back({_code.size(), target, true});
+		Emit((rs2 << 20u) | (rs1 << 15u) | (Word(func) << 12u) | Word(Opcode::Branch));
+	}
+
+	std::vector<Word> _code;
+	std::vector<size_t> _labels;
+	std::vector<Fixup> _fixups;
+};
+
+// Synthetic workloads with a result known in advance: each one computes a value, compares
+// it with the one worked out here and exits through mtohost with 0 on a match, 1 otherwise
+class ProgramGenerator
+{
+public:
+	// Code starts at the reset address, data (if any) at dataBase
+	static constexpr Word textBase = 0x200;
+	static constexpr Word dataBase = 0x10000;
+	static constexpr Word pageBytes = 0x1000;
+	// Top of guest memory kept free for the stack
+	static constexpr Word stackBytes = 64 * 1024;
+	// Largest data footprint, checked before any of it is built
+	static constexpr Word maxFootprint = memBytes - stackBytes - dataBase;
+
+	// SPEC is NAME[:KEY=VALUE,...]; on success `image` holds an ELF that LoadElf accepts
+	bool Generate(const std::string &spec, std::vector<char> &image)
+	{
+		size_t colon = spec.find(':');
+		std::string name = spec.substr(0, colon);
+		_params.clear();
+		_ok = true;
+
+		if (name == "chase")
+			_params = {{"footprint", 256 * 1024}, {"node", line_size_bytes}, {"steps", 200000}, {"seed", 1}};
+		else if (name == "stream")
+			_params = {{"footprint", 256 * 1024}, {"stride", 4}, {"passes", 4}};
+		else if (name == "branch")
+			_params = {{"iterations", 200000}, {"taken", 50}, {"seed", 1}};
+		else if (name == "calls")
+			_params = {{"depth", 32}, {"calls", 10000}};
+		else if (name == "deps")
+			_params = {{"length", 64}, {"chains", 1}, {"iterations", 10000}};
+		else
+			return Fail("unknown program \"" + name + "\"");
+
+		if (colon != std::string::npos && !ParseParams(spec.substr(colon + 1)))
+			return false;
+
+		ProgramBuilder builder;
+		_data.clear();
+		if (name == "chase")
+			Chase(builder);
+		else if (name == "stream")
+			Stream(builder);
+		else if (name == "branch")
+			Branch(builder);
+		else if (name == "calls")
+			Calls(builder);
+		else
+			Deps(builder);
+
+		std::vector<Word> code;
+		if (!_ok || !builder.Finish(code))
+			return _ok && Fail("unresolved label or branch target out of reach");
+		if (textBase + code.size() * sizeof(Word) > dataBase)
+			return Fail("program code does not fit below the data");
+		if (dataBase + _data.size() * sizeof(Word) > memBytes - stackBytes)
+			return Fail("program data does not fit in guest memory");
+
+		WriteElf(code, image);
+		return true;
+	}
+
+private:
+	// Walks a random cyclic list of `footprint / node` nodes, one pointer per node
+	void Chase(ProgramBuilder &b)
+	{
+		Word footprint = Param("footprint");
+		Word node = Param("node");
+		Word steps = Param("steps");
+		if (node < sizeof(Word) || node % sizeof(Word) != 0 || footprint / 2 < node || steps == 0)
+		{
+			Fail("chase needs node a multiple of 4, footprint of at least two nodes and steps > 0");
+			return;
+		}
+		if (footprint > maxFootprint)
+		{
+			Fail("chase footprint exceeds " + std::to_string(maxFootprint) + " bytes of guest memory");
+			return;
+		}
+
+		size_t nodes = footprint / node;
+		std::vector<size_t> next(nodes);
+		for (size_t i = 0; i < nodes; i++)
+			next[i] = i;
+		// Sattolo's algorithm: a random permutation that is a single cycle
+		std::mt19937 rng(Param("seed"));
+		for (size_t i = nodes - 1; i > 0; i--)
+			std::swap(next[i], next[std::uniform_int_distribution<size_t>(0, i - 1)(rng)]);
+
+		Word base = dataBase;
+		_data.assign(nodes * node / sizeof(Word), 0);
+		for (size_t i = 0; i < nodes; i++)
+			_data[i * node / sizeof(Word)] = base + Word(next[i] * node);
+
+		size_t at = 0;
+		for (Word i = 0; i < steps; i++)
+			at = next[at];
+
+		ProgramBuilder::Label loop = b.NewLabel();
+		b.Li(b.a0, base);
+		b.Li(b.a1, steps);
+		b.Bind(loop);
+		b.Lw(b.a0, b.a0, 0);
+		b.Addi(b.a1, b.a1, -1);
+		b.Bne(b.a1, b.zero, loop);
+		b.CheckAndExit(b.a0, base + Word(at * node));
+	}
+
+	// Reads and increments every stride-th word of the footprint, `passes` times
+	void Stream(ProgramBuilder &b)
+	{
+		Word footprint = Param("footprint");
+		Word stride = Param("stride");
+		Word passes = Param("passes");
+		if (stride < sizeof(Word) || stride % sizeof(Word) != 0 || footprint < stride || passes == 0)
+		{
+			Fail("stream needs stride a multiple of 4, footprint >= stride and passes > 0");
+			return;
+		}
+		if (footprint > maxFootprint)
+		{
+			Fail("stream footprint exceeds " + std::to_string(maxFootprint) + " bytes of guest memory");
+			return;
+		}
+
+		size_t count = footprint / stride;
+		Word base = dataBase;
+		_data.assign(count * stride / sizeof(Word), 0);
+		for (size_t i = 0; i < count; i++)
+			_data[i * stride / sizeof(Word)] = Word(3 * i + 1);
+
+		Word sum = 0;
+		for (Word pass = 0; pass < passes; pass++)
+		{
+			for (size_t i = 0; i < count; i++)
+				sum += Word(3 * i + 1) + pass;
+		}
+
+		ProgramBuilder::Label outer = b.NewLabel();
+		ProgramBuilder::Label inner = b.NewLabel();
+		b.Li(b.s0, 0);
+		b.Li(b.a2, passes);
+		b.Li(b.t2, stride);
+		b.Bind(outer);
+		b.Li(b.a0, base);
+		b.Li(b.a1, base + Word(count * stride));
+		b.Bind(inner);
+		b.Lw(b.t0, b.a0, 0);
+		b.Add(b.s0, b.s0, b.t0);
+		b.Addi(b.t0, b.t0, 1);
+		b.Sw(b.t0, b.a0, 0);
+		b.Add(b.a0, b.a0, b.t2);
+		b.Bltu(b.a0, b.a1, inner);
+		b.Addi(b.a2, b.a2, -1);
+		b.Bne(b.a2, b.zero, outer);
+		b.CheckAndExit(b.s0, sum);
+	}
+
+	// One data-dependent branch per iteration on a xorshift32 sequence, taken in about
+	// `taken` percent of them: 0 and 100 are perfectly predictable, 50 is a coin flip
+	void Branch(ProgramBuilder &b)
+	{
+		Word iterations = Param("iterations");
+		Word taken = Param("taken");
+		Word seed = Param("seed");
+		if (iterations == 0 || taken > 100 || seed == 0)
+		{
+			Fail("branch needs iterations > 0, taken <= 100 and seed != 0");
+			return;
+		}
+
+		Word threshold = taken * 256 / 100;
+		Word x = seed;
+		Word notTaken = 0;
+		for (Word i = 0; i < iterations; i++)
+		{
+			x ^= x << 13u;
+			x ^= x >> 17u;
+			x ^= x << 5u;
+			notTaken += (x & 0xffu) >= threshold;
+		}
+
+		ProgramBuilder::Label loop = b.NewLabel();
+		ProgramBuilder::Label next = b.NewLabel();
+		b.Li(b.s1, seed);
+		b.Li(b.a1, iterations);
+		b.Li(b.t2, threshold);
+		b.Li(b.s0, 0);
+		b.Bind(loop);
+		b.Slli(b.t0, b.s1, 13);
+		b.Xor(b.s1, b.s1, b.t0);
+		b.Srli(b.t0, b.s1, 17);
+		b.Xor(b.s1, b.s1, b.t0);
+		b.Slli(b.t0, b.s1, 5);
+		b.Xor(b.s1, b.s1, b.t0);
+		b.Andi(b.t1, b.s1, 0xff);
+		b.Bltu(b.t1, b.t2, next);
+		b.Addi(b.s0, b.s0, 1);
+		b.Bind(next);
+		b.Addi(b.a1, b.a1, -1);
+		b.Bne(b.a1, b.zero, loop);
+		b.CheckAndExit(b.s0, notTaken);
+	}
+
+	// `calls` times a chain of `depth` nested calls, function k adding k + 1 to s0
+	void Calls(ProgramBuilder &b)
+	{
+		Word depth = Param("depth");
+		Word calls = Param("calls");
+		if (depth == 0 || depth > maxCallDepth || calls == 0)
+		{
+			Fail("calls needs 0 < depth <= " + std::to_string(maxCallDepth) + " and calls > 0");
+			return;
+		}
+
+		std::vector<ProgramBuilder::Label> functions;
+		for (Word k = 0; k < depth; k++)
+			functions.push_back(b.NewLabel());
+
+		ProgramBuilder::Label loop = b.NewLabel();
+		b.Li(b.sp, memBytes - sizeof(Word));
+		b.Li(b.s0, 0);
+		b.Li(b.s1, calls);
+		b.Bind(loop);
+		b.Jal(b.ra, functions[0]);
+		b.Addi(b.s1, b.s1, -1);
+		b.Bne(b.s1, b.zero, loop);
+		b.CheckAndExit(b.s0, calls * (depth * (depth + 1) / 2));
+
+		for (Word k = 0; k < depth; k++)
+		{
+			b.Bind(functions[k]);
+			b.Addi(b.s0, b.s0, int32_t(k + 1));
+			if (k + 1 == depth)
+			{
+				b.Ret();
+				continue;
+			}
+			b.Addi(b.sp, b.sp, -16);
+			b.Sw(b.ra, b.sp, 12);
+			b.Jal(b.ra, functions[k + 1]);
+			b.Lw(b.ra, b.sp, 12);
+			b.Addi(b.sp, b.sp, 16);
+			b.Ret();
+		}
+	}
+
+	// `chains` independent chains of `length` dependent ALU operations each, interleaved
+	// so that consecutive instructions belong to different chains
+	void Deps(ProgramBuilder &b)
+	{
+		Word length = Param("length");
+		Word chains = Param("chains");
+		Word iterations = Param("iterations");
+		if (length == 0 || chains == 0 || chains > maxChains || uint64_t(length) * chains > maxDepsBody
+		    || iterations == 0)
+		{
+			Fail("deps needs length > 0, 0 < chains <= " + std::to_string(maxChains) + ", length * chains <= "
+			     + std::to_string(maxDepsBody) + " and iterations > 0");
+			return;
+		}
+
+		std::vector<Word> values(chains);
+		for (Word c = 0; c < chains; c++)
+			values[c] = c + 1;
+		for (Word i = 0; i < iterations; i++)
+		{
+			for (Word j = 0; j < length; j++)
+			{
+				for (Word c = 0; c < chains; c++)
+					values[c] = DepsStep(j, c, values[c]);
+			}
+		}
+		Word result = 0;
+		for (Word value : values)
+			result ^= value;
+
+		auto reg = [](Word c) { return ProgramBuilder::Reg(ProgramBuilder::s2 + c); };
+		ProgramBuilder::Label loop = b.NewLabel();
+		for (Word c = 0; c < chains; c++)
+			b.Li(reg(c), c + 1);
+		b.Li(b.a1, iterations);
+		b.Bind(loop);
+		for (Word j = 0; j < length; j++)
+		{
+			for (Word c = 0; c < chains; c++)
+			{
+				switch (j % 4)
+				{
+					case 0: b.Addi(reg(c), reg(c), DepsImm(j, c)); break;
+					case 1: b.Xori(reg(c), reg(c), DepsImm(j, c)); break;
+					case 2: b.Add(reg(c), reg(c), reg(c)); break;
+					default: b.Srli(reg(c), reg(c), 1); break;
+				}
+			}
+		}
+		b.Addi(b.a1, b.a1, -1);
+		b.Bne(b.a1, b.zero, loop);
+		b.Li(b.s0, 0);
+		for (Word c = 0; c < chains; c++)
+			b.Xor(b.s0, b.s0, reg(c));
+		b.CheckAndExit(b.s0, result);
+	}
+
+	static int32_t DepsImm(Word j, Word c)
+	{
+		return int32_t((j * 37 + c * 11 + 1) & 0x3ffu);
+	}
+
+	// What the instruction Deps emits for step j of chain c computes
+	static Word DepsStep(Word j, Word c, Word value)
+	{
+		switch (j % 4)
+		{
+			case 0: return value + Word(DepsImm(j, c));
+			case 1: return value ^ Word(DepsImm(j, c));
+			case 2: return value + value;
+			default: return value >> 1u;
+		}
+	}
+
+	bool ParseParams(const std::string &list)
+	{
+		size_t begin = 0;
+		while (begin <= list.size())
+		{
+			size_t end = std::min(list.find(',', begin), list.size());
+			std::string param = list.substr(begin, end - begin);
+			size_t eq = param.find('=');
+			std::string key = param.substr(0, eq);
+			if (eq == std::string::npos || _params.find(key) == _params.end())
+				return Fail("unknown parameter \"" + param + "\"");
+
+			const char *value = param.c_str() + eq + 1;
+			char *valueEnd = nullptr;
+			unsigned long long parsed = strtoull(value, &valueEnd, 0);
+			if (*value == '\0' || *valueEnd != '\0' || parsed > 0xffffffffull)
+				return Fail("bad value in \"" + param + "\"");
+			_params[key] = Word(parsed);
+			begin = end + 1;
+		}
+		return true;
+	}
+
+	Word Param(const std::string &key) const
+	{
+		return _params.at(key);
+	}
+
+	bool Fail(const std::string &message)
+	{
+		fprintf(stderr, "ERROR: generate: %s\n", message.c_str());
+		_ok = false;
+		return false;
+	}
+
+	// One PT_LOAD segment for code and, if there is data, one for data; file offsets match
+	// the addresses modulo the page size, so LoadElf can map the data from a file
+	void WriteElf(const std::vector<Word> &code, std::vector<char> &image) const
+	{
+		Word codeBytes = Word(code.size() * sizeof(Word));
+		Word dataBytes = Word(_data.size() * sizeof(Word));
+		Word dataOffset = (textBase + codeBytes + pageBytes - 1) / pageBytes * pageBytes;
+		int segments = dataBytes > 0 ? 2 : 1;
+
+		image.assign(dataOffset + dataBytes, 0);
+
+		Elf32_Ehdr ehdr {};
+		memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+		ehdr.e_ident[EI_CLASS] = ELFCLASS32;
+		ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+		ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+		ehdr.e_type = ET_EXEC;
+		ehdr.e_machine = emRiscv;
+		ehdr.e_version = EV_CURRENT;
+		ehdr.e_entry = textBase;
+		ehdr.e_phoff = sizeof(Elf32_Ehdr);
+		ehdr.e_ehsize = sizeof(Elf32_Ehdr);
+		ehdr.e_phentsize = sizeof(Elf32_Phdr);
+		ehdr.e_phnum = segments;
+		ehdr.e_shentsize = sizeof(Elf32_Shdr);
+		memcpy(image.data(), &ehdr, sizeof(ehdr));
+
+		Elf32_Phdr phdr[2] {};
+		phdr[0] = {PT_LOAD, textBase, textBase, textBase, codeBytes, codeBytes, PF_R | PF_X, pageBytes};
+		phdr[1] = {PT_LOAD, dataOffset, dataBase, dataBase, dataBytes, dataBytes, PF_R | PF_W, pageBytes};
+		memcpy(image.data() + sizeof(ehdr), phdr, segments * sizeof(Elf32_Phdr));
+
+		memcpy(image.data() + textBase, code.data(), codeBytes);
+		memcpy(image.data() + dataOffset, _data.data(), dataBytes);
+	}
+
+	static constexpr Elf32_Half emRiscv = 243;
+	static constexpr Word maxCallDepth = 2000;
+	static constexpr Word maxChains = 8;
+	static constexpr Word maxDepsBody = 8192;
+
+	std::map<std::string, Word> _params;
+	std::vector<Word> _data;
+	bool _ok = true;
+};
+
+#endif //RISCV_SIM_GENERATOR_H
@@ -0,0 +1,149 @@
+#ifndef RISCV_SIM_HOST_H
+#define RISCV_SIM_HOST_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+
+#include "BaseTypes.h"
+#include "Memory/HostIoDevice.h"
+
+struct HostState
+{
+	int32_t print_int = 0;
+	int exitCode = 0;
+	// Sweep children and repeated sampling passes run silently
+	bool quiet = false;
+	// Guests print one character per message; the characters are collected in
+	// `pending` and written out a line (or guestOutputFlushBytes) at a time
+	FILE *output = stderr;
+	std::string pending;
+	// Device behind CpuToHostType::HostIo messages; without one they are ignored
+	HostIoDevice *io = nullptr;
+	// HostIoCommand::Array requests are written to <arrayPrefix><tag>.bin, or dropped
+	// if no prefix is set. Later requests with the same tag append to the file, so
+	// arrays larger than the buffer can be sent in pieces
+	std::string arrayPrefix;
+	std::set<Word> arrayTags;
+};
+
+static constexpr size_t guestOutputFlushBytes = 4096;
+
+// Exit statuses of runs the simulator ended itself (see HaltReason), apart from the
+// guest's exit codes and 1 for the simulator's own errors; 124 as for timeout(1)
+static constexpr int watchdogExitStatus = 124;
+static constexpr int idleLoopExitStatus = 125;
+
+// Writes out buffered guest output; due at newlines, when the buffer fills up, before
+// the simulator prints to the same stream and at exit
+inline void FlushGuestOutput(HostState &host)
+{
+	if (host.pending.empty())
+		return;
+	fwrite(host.pending.data(), 1, host.pending.size(), host.output);
+	host.pending.clear();
+}
+
+inline void PutGuestOutput(HostState &host, const std::string &text)
+{
+	if (text.empty())
+		return;
+	host.pending += text;
+	if (host.pending.size() >= guestOutputFlushBytes || host.pending.back() == '\n')
+		FlushGuestOutput(host);
+}
+
+// Serves one request drained from the host I/O device
+inline void HandleHostIo(const HostIoRequest &request, HostState &host)
+{
+	if (request.command == HostIoCommand::Console)
+	{
+		PutGuestOutput(host, request.data);
+	}
+	else if (request.command == HostIoCommand::Words)
+	{
+		std::string line;
+		for (size_t i = 0; i + sizeof(Word) <= request.data.size(); i += sizeof(Word))
+		{
+			int32_t value;
+			memcpy(&value, request.data.data() + i, sizeof(value));
+			line += (i ? " " : "") + std::to_string(value);
+		}
+		PutGuestOutput(host, line + "\n");
+	}
+	else if (request.command == HostIoCommand::Array && !host.arrayPrefix.empty())
+	{
+		std::string filename = host.arrayPrefix + std::to_string(request.tag) + ".bin";
+		FILE *file = fopen(filename.c_str(), host.arrayTags.insert(request.tag).second ? "wb" : "ab");
+		bool written = file != nullptr && fwrite(request.data.data(), 1, request.data.size(), file) == request.data.size();
+		if (file != nullptr && fclose(file) != 0)
+			written = false;
+		if (!written)
+			fprintf(stderr, "ERROR: failed writing result array \"%s\"\n", filename.c_str());
+	}
+	else if (request.command != HostIoCommand::Array)
+	{
+		fprintf(stderr, "ERROR: unknown host I/O command %u\n", unsigned(request.command));
+	}
+}
+
+// Returns true once the guest has exited
+inline bool HandleMessage(CpuToHostData msg, HostState &host)
+{
+	auto type = msg.unpacked.type;
+	auto data = msg.unpacked.data;
+
+	if (type == CpuToHostType::ExitCode)
+	{
+		host.exitCode = data;
+		FlushGuestOutput(host);
+		if (host.quiet)
+			return true;
+
+		if (data == 0)
+			fprintf(stderr, "PASSED\n");
+		else
+			fprintf(stderr, "FAILED: exit code = %d\n", data);
+		return true;
+	}
+	else if (type == CpuToHostType::Halt)
+	{
+		bool watchdog = HaltReason(data) == HaltReason::Watchdog;
+		host.exitCode = watchdog ? watchdogExitStatus : idleLoopExitStatus;
+		FlushGuestOutput(host);
+		if (host.quiet)
+			return true;
+
+		if (watchdog)
+			fprintf(stderr, "HALTED: watchdog expired before the guest exited\n");
+		else
+			fprintf(stderr, "HALTED: guest loops on itself without exiting\n");
+		return true;
+	}
+	else if (host.quiet)
+	{
+		return false;
+	}
+	else if (type == CpuToHostType::PrintChar)
+	{
+		PutGuestOutput(host, std::string(1, char(data)));
+	}
+	else if (type == CpuToHostType::PrintIntLow)
+	{
+		host.print_int = uint32_t(data);
+	}
+	else if (type == CpuToHostType::PrintIntHigh)
+	{
+		host.print_int |= uint32_t(data) << 16;
+		PutGuestOutput(host, std::to_string(host.print_int));
+	}
+	else if (type == CpuToHostType::HostIo && host.io != nullptr)
+	{
+		HandleHostIo(host.io->Drain(), host);
+	}
+	return false;
+}
+
+#endif //RISCV_SIM_HOST_H
@@ -0,0 +1,201 @@
+#ifndef RISCV_SIM_HOSTPROFILER_H
+#define RISCV_SIM_HOSTPROFILER_H
+
+#include "Instrumentation.h"
+#include "Stats.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// How fast the simulator itself runs: wall time, simulated instructions and cycles per
+// host second, and the host time spent in each component of the CPU model. Timing
+// every component of every cycle would cost more than the components themselves, so
+// only one cycle in samplePeriod is timed, lap by lap; on those cycles the progress
+// line and the watchdog are also due-checked. Even untaken, the laps slow the default build down by
+// about 10%, so they only exist in the instrumented one
+class HostProfiler
+{
+public:
+	enum Component
+	{
+		Decode,
+		Execute,
+		RegisterFile,
+		Csr,
+		Memory,
+		// Cpu bookkeeping and guest profilers
+		Other,
+		NumComponents
+	};
+
+	void EnableSampling()
+	{
+		_countdown = samplePeriod;
+	}
+
+	void EnableProgress(double seconds)
+	{
+		EnableSampling();
+		_progressSeconds = seconds;
+	}
+
+	// Ends the run after `cycles` simulated cycles or `seconds` of host time since
+	// Start(), zero meaning no limit. Checked every samplePeriod cycles only, so the
+	// run may overshoot by that many
+	void EnableWatchdog(uint64_t cycles, double seconds)
+	{
+		EnableSampling();
+		_maxCycles = cycles;
+		_maxSeconds = seconds;
+	}
+
+	void Start()
+	{
+		_start = Clock::now();
+		_lastProgress = _start;
+	}
+
+	void Stop()
+	{
+		_seconds += Seconds(_start, Clock::now());
+	}
+
+	// Called at the start of every simulated cycle; returns true once the watchdog expires
+	bool BeginCycle(uint64_t instret, uint64_t cycle)
+	{
+		if (--_countdown != 0)
+			return false;
+		_countdown = samplePeriod;
+		Progress(instret, cycle);
+		if constexpr (instrumented)
+		{
+			_sampling = true;
+			_last = Ticks();
+		}
+		return Expired(cycle);
+	}
+
+	// Charges the host time since the previous lap to `component`
+	void Lap(Component component)
+	{
+		if (!instrumented || !_sampling)
+			return;
+		uint64_t now = Ticks();
+		_ticks[component] += now - _last;
+		_last = now;
+	}
+
+	void EndCycle()
+	{
+		if (!instrumented || !_sampling)
+			return;
+		Lap(Other);
+		_sampling = false;
+	}
+
+	void RegisterStats(StatsRegistry &stats)
+	{
+		static const char *componentNames[NumComponents] = {
+				"decode", "execute", "register_file", "csr", "memory", "other"};
+
+		stats.AddFormula("host.seconds", [this] { return _seconds; });
+		stats.AddFormula("host.mips", [this, &stats] {
+			return StatsRegistry::Ratio(stats.Value("csr.instret") / 1e6, _seconds);
+		});
+		stats.AddFormula("host.mcycles_per_second", [this, &stats] {
+			return StatsRegistry::Ratio(stats.Value("csr.cycle") / 1e6, _seconds);
+		});
+		if constexpr (instrumented)
+			stats.AddHistogram("host.component_ticks", _ticks.data(),
+			                   std::vector<std::string>(componentNames, componentNames + NumComponents));
+	}
+
+	void Report(FILE *out, uint64_t instret, uint64_t cycle) const
+	{
+		static const char *componentNames[NumComponents] = {
+				"decode", "execute", "register file", "csr", "memory model", "other"};
+
+		fprintf(out, "host: %.3f s, %.2f MIPS, %.2f M simulated cycles/s\n", _seconds,
+		        _seconds ? instret / _seconds / 1e6 : 0.0, _seconds ? cycle / _seconds / 1e6 : 0.0);
+
+		if constexpr (!instrumented)
+		{
+			fprintf(out, "host time per component: only measured by riscv_sim_instrumented\n\n");
+			return;
+		}
+
+		uint64_t total = 0;
+		for (uint64_t ticks : _ticks)
+			total += ticks;
+		fprintf(out, "host time per component (1 cycle in %lu timed):\n", (unsigned long) samplePeriod);
+		for (size_t i = 0; i < NumComponents; i++)
+			fprintf(out, "  %-14s %6.2f%%\n", componentNames[i], total ? 100.0 * _ticks[i] / total : 0.0);
+		fprintf(out, "\n");
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+	static constexpr uint64_t samplePeriod = 256;
+
+	static double Seconds(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<double>(to - from).count();
+	}
+
+	// Prints a progress line to stderr if one is due
+	void Progress(uint64_t instret, uint64_t cycle)
+	{
+		if (_progressSeconds <= 0)
+			return;
+		Clock::time_point now = Clock::now();
+		double sinceLast = Seconds(_lastProgress, now);
+		if (sinceLast < _progressSeconds)
+			return;
+
+		fprintf(stderr, "progress: %.1f s, instret %lu, cycle %lu, %.2f MIPS\n", Seconds(_start, now),
+		        (unsigned long) instret, (unsigned long) cycle, (instret - _lastInstret) / sinceLast / 1e6);
+		_lastProgress = now;
+		_lastInstret = instret;
+	}
+
+	bool Expired(uint64_t cycle) const
+	{
+		if (_maxCycles != 0 && cycle >= _maxCycles)
+			return true;
+		return _maxSeconds > 0 && Seconds(_start, Clock::now()) >= _maxSeconds;
+	}
+
+	// Cheapest available timestamp; only ratios between components are reported, so
+	// the unit does not matter
+	static uint64_t Ticks()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return Clock::now().time_since_epoch().count();
+#endif
+	}
+
+	// Zero keeps sampling off: the first decrement wraps around
+	uint64_t _countdown = 0;
+	bool _sampling = false;
+	uint64_t _last = 0;
+	std::array<uint64_t, NumComponents> _ticks {};
+
+	Clock::time_point _start;
+	double _seconds = 0;
+
+	double _progressSeconds = 0;
+	Clock::time_point _lastProgress;
+	uint64_t _lastInstret = 0;
+
+	uint64_t _maxCycles = 0;
+	double _maxSeconds = 0;
+};
+
+#endif //RISCV_SIM_HOSTPROFILER_H
@@ -29,6 +29,13 @@ enum class CsrIdx : RId
 {
     Instret = 0xc02,
     Cycle   = 0xc00,
+    InstretH = 0xc82,
+    CycleH  = 0xc80,
+    // Machine-mode aliases of the counters above
+    Minstret = 0xb02,
+    Mcycle  = 0xb00,
+    MinstretH = 0xb82,
+    McycleH = 0xb80,
     Mhartid = 0xf10,
     Mtohost = 0x780,
     None    = 0xfff,
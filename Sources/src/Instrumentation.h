@@ -0,0 +1,13 @@
+#ifndef RISCV_SIM_INSTRUMENTATION_H
+#define RISCV_SIM_INSTRUMENTATION_H
+
+// Detailed counters (stall cycles, histograms, branch and load/store breakdowns) are
+// only maintained in the riscv_sim_instrumented build. Every hook is guarded by
+// `if constexpr (instrumented)`, so the default build compiles them out entirely
+#ifdef RISCV_SIM_INSTRUMENTED
+constexpr bool instrumented = true;
+#else
+constexpr bool instrumented = false;
+#endif
+
+#endif //RISCV_SIM_INSTRUMENTATION_H
@@ -0,0 +1,43 @@
+#ifndef RISCV_SIM_MARKER_H
+#define RISCV_SIM_MARKER_H
+
+#include "Cpu.h"
+#include "BaseTypes.h"
+
+// A point in guest execution the host can run to: an instruction address, a number of
+// retired instructions, a CpuToHostType::Marker message carrying a given tag or the
+// next read of the cycle CSR
+struct Marker
+{
+	enum class Kind
+	{
+		None,
+		Pc,
+		Instret,
+		ToHost,
+		CycleRead
+	};
+	Kind kind = Kind::None;
+	uint64_t value = 0;
+
+	bool IsSet() const
+	{
+		return kind != Kind::None;
+	}
+
+	// Only meaningful at an instruction boundary
+	template<typename Memory>
+	bool Reached(const BasicCpu<Memory> &cpu) const
+	{
+		return (kind == Kind::Pc && cpu.GetIp() == value)
+		       || (kind == Kind::Instret && cpu.GetInstret() >= value)
+		       || (kind == Kind::CycleRead && cpu.NextReadsCycle());
+	}
+
+	bool Matches(CpuToHostData msg) const
+	{
+		return kind == Kind::ToHost && msg.unpacked.type == CpuToHostType::Marker && msg.unpacked.data == value;
+	}
+};
+
+#endif //RISCV_SIM_MARKER_H
@@ -0,0 +1,198 @@
+#ifndef RISCV_SIM_ACCESSTRACE_H
+#define RISCV_SIM_ACCESSTRACE_H
+
+#include "CachedMemory.h"
+#include "ICacheObserver.h"
+#include "IMemory.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Memory access traces are a header followed by fixed-size records, one per request
+// reaching CachedMemory: the address, the kind of access and the number of cycles the
+// requester spent since its previous access completed. Replaying them keeps those gaps,
+// so a memory model sees the same timing as under the real CPU
+static constexpr uint32_t accessTraceMagic = 0x414d5652; // "RVMA"
+static constexpr uint32_t accessTraceVersion = 1;
+
+struct AccessRecord
+{
+	static constexpr uint32_t kindBits = 2;
+	static constexpr uint32_t maxGap = (1u << (32 - kindBits)) - 1;
+
+	Word addr;
+	// Gap << kindBits | AccessKind
+	uint32_t gapKind;
+
+	AccessKind Kind() const
+	{
+		return AccessKind(gapKind & ((1u << kindBits) - 1));
+	}
+
+	uint32_t Gap() const
+	{
+		return gapKind >> kindBits;
+	}
+};
+
+class AccessCapture : public ICacheObserver
+{
+public:
+	explicit AccessCapture(const CachedMemory &cache)
+			: _cache(cache)
+	{
+	}
+
+	~AccessCapture() override
+	{
+		Close();
+	}
+
+	bool Open(const std::string &filename)
+	{
+		_file = fopen(filename.c_str(), "wb");
+		if (_file == nullptr)
+		{
+			fprintf(stderr, "ERROR: failed opening access trace file \"%s\"\n", filename.c_str());
+			return false;
+		}
+		uint32_t header[] = {accessTraceMagic, accessTraceVersion};
+		_ok = fwrite(header, sizeof(header), 1, _file) == 1;
+		_buffer.reserve(bufferRecords);
+		return _ok;
+	}
+
+	void Access(AccessKind kind, Word, Word addr, bool) override
+	{
+		uint64_t gap = std::min<uint64_t>(_cache.IdleCycles(), AccessRecord::maxGap);
+		_buffer.push_back({addr, uint32_t(gap << AccessRecord::kindBits) | uint32_t(kind)});
+		if (_buffer.size() == bufferRecords)
+			Flush();
+	}
+
+	bool Close()
+	{
+		if (_file == nullptr)
+			return _ok;
+		Flush();
+		if (fclose(_file) != 0)
+			_ok = false;
+		_file = nullptr;
+		if (!_ok)
+			fprintf(stderr, "ERROR: failed writing the access trace file\n");
+		return _ok;
+	}
+
+private:
+	static constexpr size_t bufferRecords = 64 * 1024;
+
+	void Flush()
+	{
+		if (!_buffer.empty() && fwrite(_buffer.data(), sizeof(AccessRecord), _buffer.size(), _file) != _buffer.size())
+			_ok = false;
+		_buffer.clear();
+	}
+
+	const CachedMemory &_cache;
+	FILE *_file = nullptr;
+	bool _ok = true;
+	std::vector<AccessRecord> _buffer;
+};
+
+// Maps a whole access trace for reading it front to back
+class AccessTraceReader
+{
+public:
+	~AccessTraceReader()
+	{
+		if (_map != MAP_FAILED)
+			munmap(_map, _size);
+	}
+
+	bool Open(const std::string &filename)
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		struct stat st {};
+		if (fd < 0 || fstat(fd, &st) != 0)
+		{
+			fprintf(stderr, "ERROR: failed opening access trace file \"%s\"\n", filename.c_str());
+			if (fd >= 0)
+				close(fd);
+			return false;
+		}
+		_size = st.st_size;
+		if (_size >= headerBytes)
+			_map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		auto header = static_cast<const uint32_t *>(_map);
+		if (_map == MAP_FAILED || header[0] != accessTraceMagic || header[1] != accessTraceVersion
+		    || (_size - headerBytes) % sizeof(AccessRecord) != 0)
+		{
+			fprintf(stderr, "ERROR: \"%s\" is not an access trace of this simulator version\n", filename.c_str());
+			return false;
+		}
+		madvise(_map, _size, MADV_SEQUENTIAL);
+		return true;
+	}
+
+	const AccessRecord *begin() const
+	{
+		return reinterpret_cast<const AccessRecord *>(static_cast<const char *>(_map) + headerBytes);
+	}
+
+	const AccessRecord *end() const
+	{
+		return begin() + (_size - headerBytes) / sizeof(AccessRecord);
+	}
+
+private:
+	static constexpr size_t headerBytes = 2 * sizeof(uint32_t);
+
+	void *_map = MAP_FAILED;
+	size_t _size = 0;
+};
+
+// Feeds a captured access stream to a memory model the way the CPU drives it: idle
+// cycles first, then the request, which completes after its busy cycles. Both are
+// clocked in one step rather than cycle by cycle, which gives the same timing as a
+// response polled once per cycle. Returns the number of cycles taken. Stores write
+// zeros; replayed timing does not depend on the data
+static uint64_t ReplayAccesses(const AccessTraceReader &trace, IMemory &mem)
+{
+	uint64_t cycles = 0;
+	InstructionPtr instr(new Instruction());
+	instr->_data = 0;
+	for (const AccessRecord &record : trace)
+	{
+		mem.Clock(record.Gap());
+		cycles += record.Gap();
+
+		if (record.Kind() == AccessKind::Fetch)
+		{
+			mem.Request(record.addr);
+			uint64_t busy = mem.BusyCycles();
+			mem.Clock(busy);
+			for (cycles += busy; !mem.Response(); cycles++)
+				mem.Clock();
+		}
+		else
+		{
+			instr->_type = record.Kind() == AccessKind::Load ? IType::Ld : IType::St;
+			instr->_addr = record.addr;
+			mem.Request(instr);
+			uint64_t busy = mem.BusyCycles();
+			mem.Clock(busy);
+			for (cycles += busy; !mem.Response(instr); cycles++)
+				mem.Clock();
+		}
+	}
+	return cycles;
+}
+
+#endif //RISCV_SIM_ACCESSTRACE_H
@@ -6,12 +6,17 @@
 #define RISCV_SIM_CACHEDMEMORY_H
 
 #include "IMemory.h"
+#include "ICacheObserver.h"
 #include "MemoryStorage.h"
+#include "../Checkpoint.h"
+#include "../Stats.h"
+#include "../Instrumentation.h"
 
-class CachedMemory : public IMemory
+class CachedMemory final : public IMemory
 {
 public:
-	explicit CachedMemory(MemoryStorage &amem): _mem(amem) { }
+	explicit CachedMemory(MemoryStorage &amem, const CacheConfig &config = CacheConfig())
+			: _config(config), _mem(amem) { }
 
 	void Request(Word ip)
 	{
@@ -30,6 +35,11 @@ public:
 			}
 		}
 		_requested_address = ip;
+		_fetch_ip = ip;
+		_stats.codeAccesses++;
+		_stats.codeMisses += !_cached;
+		for (ICacheObserver *observer : _observers)
+			observer->Access(AccessKind::Fetch, ip, ip, _cached);
 	}
 
 	std::__1::optional<Word> Response()
@@ -42,7 +52,8 @@ public:
 		if (_cached)
 		{
 			size_t offset = to_line_offset(_requested_address);
-			_cached_code_map[_tag] = clock();
+			_cached_code_map[_tag] = Tick();
+			_ready_cycle = _cycle;
 			return _line[offset];
 		}
 
@@ -57,18 +68,13 @@ public:
 		}
 
 		auto new_record = std::make_pair(_tag, new_line);
-		if (_code_cache.size() >= codeCacheBytes / line_size_bytes)
+		if (_code_cache.size() >= _config.codeBytes / line_size_bytes)
 		{
-			auto min = *std::min_element(
-					_cached_code_map.begin(),
-					_cached_code_map.end(),
-					CompareSecond());
-
-			_data_cache.erase(min.first);
-			_cached_code_map.erase(min.first);
+			EvictCode();
 		}
 		_code_cache.push_back(new_record);
-		_cached_code_map.insert({_tag, clock()});
+		_cached_code_map.insert({_tag, Tick()});
+		_ready_cycle = _cycle;
 		return response;
 	}
 
@@ -77,6 +83,14 @@ public:
 		if (instr->_type != IType::Ld && instr->_type != IType::St)
 			return;
 
+		// The host I/O device is not cached and not part of the observed access stream
+		_io_access = HostIoDevice::Decodes(instr->_addr);
+		if (_io_access)
+		{
+			_incomplete_iterations_count = _host_io_latency;
+			return;
+		}
+
 		_tag = to_line_addr(instr->_addr) / line_size_bytes;
 		_cached = false;
 		_incomplete_iterations_count = _latency;
@@ -87,6 +101,24 @@ public:
 			_incomplete_iterations_count = 3;
 		}
 		_requested_address = instr->_addr;
+		_stats.dataAccesses++;
+		_stats.dataMisses += !_cached;
+		for (ICacheObserver *observer : _observers)
+			observer->Access(instr->_type == IType::Ld ? AccessKind::Load : AccessKind::Store,
+			                 _fetch_ip, instr->_addr, _cached);
+		if constexpr (instrumented)
+		{
+			if (instr->_type == IType::Ld)
+			{
+				_access_stats.loads++;
+				_access_stats.loadMisses += !_cached;
+			}
+			else
+			{
+				_access_stats.stores++;
+				_access_stats.storeMisses += !_cached;
+			}
+		}
 	}
 
 	bool Response(InstructionPtr &instr)
@@ -101,12 +133,19 @@ public:
 			return false;
 		}
 
+		if (_io_access)
+		{
+			AccessHostIo(instr);
+			_ready_cycle = _cycle;
+			return true;
+		}
+
 		if (!_cached)
 		{
 			SaveInCache();
 		}
 
-		_cached_data_map[_tag] = clock();
+		_cached_data_map[_tag] = Tick();
 
 		if (instr->_type == IType::Ld)
 		{
@@ -118,6 +157,7 @@ public:
 			_data_cache[_tag].second = false;
 		}
 
+		_ready_cycle = _cycle;
 		return true;
 	}
 
@@ -132,13 +172,13 @@ public:
 		}
 
 		std::__1::pair<Line, bool> new_record = std::make_pair(new_line, true);
-		if (_data_cache.size() >= dataCacheBytes / line_size_bytes)
+		if (_data_cache.size() >= _config.dataBytes / line_size_bytes)
 		{
 			CleanCache();
 		}
 
 		_data_cache.insert({_tag, new_record});
-		_cached_data_map.insert({_tag, clock()});
+		_cached_data_map.insert({_tag, Tick()});
 	}
 
 	void CleanCache()
@@ -149,6 +189,7 @@ public:
 
 		if (!this->_data_cache[tag_of_min].second)
 		{
+			_stats.writebacks++;
 			size_t ip = tag_of_min * line_size_bytes;
 			Line line = this->_data_cache[tag_of_min].first;
 			for (auto iter = line.begin(); iter != line.end(); iter++)
@@ -162,12 +203,225 @@ public:
 		this->_cached_data_map.erase(tag_of_min);
 	}
 
+	// Writes back dirty lines and empties both caches
+	void Flush()
+	{
+		while (!_data_cache.empty())
+			CleanCache();
+		_code_cache.clear();
+		_cached_code_map.clear();
+		for (ICacheObserver *observer : _observers)
+			observer->Flushed();
+	}
+
+	// Untimed accesses for functional simulation. A warming access updates cache contents
+	// and LRU state like a timed one; a cold access goes straight to memory and is only
+	// valid while the cache holds no dirty lines (see Flush)
+	Word FetchFunctional(Word ip, bool warm)
+	{
+		if (!warm)
+			return _mem.Read(ip);
+
+		Request(ip);
+		_incomplete_iterations_count = 0;
+		return *Response();
+	}
+
+	void AccessFunctional(InstructionPtr &instr, bool warm)
+	{
+		if (!warm)
+		{
+			if ((instr->_type == IType::Ld || instr->_type == IType::St) && HostIoDevice::Decodes(instr->_addr))
+				AccessHostIo(instr);
+			else if (instr->_type == IType::Ld)
+				instr->_data = _mem.Read(instr->_addr);
+			else if (instr->_type == IType::St)
+				_mem.Write(instr->_addr, instr->_data);
+			return;
+		}
+
+		Request(instr);
+		_incomplete_iterations_count = 0;
+		Response(instr);
+	}
+
+	void AccessHostIo(InstructionPtr &instr)
+	{
+		if (instr->_type == IType::Ld)
+			instr->_data = _mem.GetHostIo().Read(instr->_addr);
+		else
+			_mem.GetHostIo().Write(instr->_addr, instr->_data);
+	}
+
+	HostIoDevice &GetHostIo()
+	{
+		return _mem.GetHostIo();
+	}
+
+	// Reads memory without touching the cache, for inspecting code only
+	Word Peek(Word ip) const
+	{
+		return _mem.Read(ip);
+	}
+
+	// Reads data as the program sees it, including dirty cached lines, without touching
+	// the cache
+	Word PeekData(Word addr) const
+	{
+		auto line = _data_cache.find(to_line_addr(addr) / line_size_bytes);
+		return line != _data_cache.end() ? line->second.first[to_line_offset(addr)] : _mem.Read(addr);
+	}
+
+	void EvictCode()
+	{
+		auto min = std::min_element(_cached_code_map.begin(), _cached_code_map.end(), CompareSecond());
+		auto tag_of_min = min->first;
+
+		_code_cache.erase(std::find_if(_code_cache.begin(), _code_cache.end(),
+		                               [tag_of_min](auto &record) { return record.first == tag_of_min; }));
+		_cached_code_map.erase(tag_of_min);
+	}
+
+	// Changes cache capacities on the fly, evicting (and writing back) least recently
+	// used lines until the contents fit
+	void Configure(const CacheConfig &config)
+	{
+		_config = config;
+		while (_data_cache.size() > _config.dataBytes / line_size_bytes)
+			CleanCache();
+		while (_code_cache.size() > _config.codeBytes / line_size_bytes)
+			EvictCode();
+	}
+
+	const CacheConfig &GetConfig() const
+	{
+		return _config;
+	}
+
+	const CacheStats &GetStats() const
+	{
+		return _stats;
+	}
+
+	void AddObserver(ICacheObserver *observer)
+	{
+		_observers.push_back(observer);
+	}
+
+	void RegisterStats(StatsRegistry &stats)
+	{
+		_mem.GetHostIo().RegisterStats(stats);
+		stats.AddCounter("cache.code_accesses", _stats.codeAccesses);
+		stats.AddCounter("cache.code_misses", _stats.codeMisses);
+		stats.AddCounter("cache.data_accesses", _stats.dataAccesses);
+		stats.AddCounter("cache.data_misses", _stats.dataMisses);
+		stats.AddCounter("cache.writebacks", _stats.writebacks);
+		if constexpr (instrumented)
+		{
+			stats.AddCounter("cache.loads", _access_stats.loads);
+			stats.AddCounter("cache.load_misses", _access_stats.loadMisses);
+			stats.AddCounter("cache.stores", _access_stats.stores);
+			stats.AddCounter("cache.store_misses", _access_stats.storeMisses);
+		}
+		stats.AddFormula("cache.code_miss_rate", [this] {
+			return StatsRegistry::Ratio(_stats.codeMisses, _stats.codeAccesses);
+		});
+		stats.AddFormula("cache.data_miss_rate", [this] {
+			return StatsRegistry::Ratio(_stats.dataMisses, _stats.dataAccesses);
+		});
+	}
+
 	void Clock()
 	{
+		_cycle++;
 		if (_incomplete_iterations_count > 0)
 			--_incomplete_iterations_count;
 	}
 
+	void Clock(uint64_t cycles)
+	{
+		_cycle += cycles;
+		_incomplete_iterations_count -= std::min<uint64_t>(cycles, _incomplete_iterations_count);
+	}
+
+	uint64_t BusyCycles() const
+	{
+		return _incomplete_iterations_count;
+	}
+
+	// Cycles since the last request completed, i.e. how long the requester was busy
+	// elsewhere before making the current one
+	uint64_t IdleCycles() const
+	{
+		return _cycle - _ready_cycle;
+	}
+
+	void Save(CheckpointWriter &cp) const
+	{
+		cp.PutMap(_cached_code_map);
+		cp.PutMap(_cached_data_map);
+		cp.Put(_lru_clock);
+		cp.Put(_requested_address);
+		cp.Put(_incomplete_iterations_count);
+		cp.Put(_tag);
+		cp.Put(_line);
+		cp.Put(_cached);
+		cp.Put(_io_access);
+		cp.Put(_config);
+		cp.Put(_stats);
+		cp.Put(_access_stats);
+		cp.Put(_cycle);
+		cp.Put(_ready_cycle);
+
+		cp.Put(_code_cache.size());
+		for (auto &[tag, line] : _code_cache)
+		{
+			cp.Put(tag);
+			cp.Put(line);
+		}
+
+		cp.Put(_data_cache.size());
+		for (auto &[tag, record] : _data_cache)
+		{
+			cp.Put(tag);
+			cp.Put(record.first);
+			cp.Put(record.second);
+		}
+	}
+
+	void Restore(CheckpointReader &cp)
+	{
+		cp.GetMap(_cached_code_map);
+		cp.GetMap(_cached_data_map);
+		cp.Get(_lru_clock);
+		cp.Get(_requested_address);
+		cp.Get(_incomplete_iterations_count);
+		cp.Get(_tag);
+		cp.Get(_line);
+		cp.Get(_cached);
+		cp.Get(_io_access);
+		cp.Get(_config);
+		cp.Get(_stats);
+		cp.Get(_access_stats);
+		cp.Get(_cycle);
+		cp.Get(_ready_cycle);
+
+		_code_cache.clear();
+		for (size_t n = cp.Get<size_t>(); n > 0 && cp.Ok(); n--)
+		{
+			size_t tag = cp.Get<size_t>();
+			_code_cache.emplace_back(tag, cp.Get<Line>());
+		}
+
+		_data_cache.clear();
+		for (size_t n = cp.Get<size_t>(); n > 0 && cp.Ok(); n--)
+		{
+			size_t tag = cp.Get<size_t>();
+			Line line = cp.Get<Line>();
+			_data_cache[tag] = std::make_pair(line, cp.Get<bool>());
+		}
+	}
+
 private:
 	struct CompareSecond
 	{
@@ -177,11 +431,35 @@ private:
 		}
 	};
 
-	std::__1::map<size_t, clock_t> _cached_code_map;
-	std::__1::map<size_t, clock_t> _cached_data_map;
+	LruClock Tick()
+	{
+		return ++_lru_clock;
+	}
+
+	std::__1::map<size_t, LruClock> _cached_code_map;
+	std::__1::map<size_t, LruClock> _cached_data_map;
+	LruClock _lru_clock = 0;
+	CacheConfig _config;
+	CacheStats _stats;
+
+	struct AccessStats
+	{
+		uint64_t loads = 0;
+		uint64_t loadMisses = 0;
+		uint64_t stores = 0;
+		uint64_t storeMisses = 0;
+	};
+	AccessStats _access_stats;
+
+	// A data request always follows the fetch of its own instruction
+	Word _fetch_ip = 0;
+	std::vector<ICacheObserver *> _observers;
 	static constexpr size_t _latency = 152;
+	static constexpr size_t _host_io_latency = 1;
 	Word _requested_address = 0;
 	size_t _incomplete_iterations_count = 0;
+	uint64_t _cycle = 0;
+	uint64_t _ready_cycle = 0;
 
 	size_t _tag;
 	Line _line;
@@ -189,6 +467,7 @@ private:
 	std::__1::vector<std::__1::pair<size_t, Line>> _code_cache;
 	std::__1::map<size_t, std::__1::pair<Line, bool>> _data_cache;
 	bool _cached = false;
+	bool _io_access = false;
 };
 
 #endif //RISCV_SIM_CACHEDMEMORY_H
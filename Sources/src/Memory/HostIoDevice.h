@@ -0,0 +1,168 @@
+#ifndef RISCV_SIM_HOSTIODEVICE_H
+#define RISCV_SIM_HOSTIODEVICE_H
+
+#include "../BaseTypes.h"
+#include "../Checkpoint.h"
+#include "../Stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Memory-mapped channel for bulk guest to host transfers, placed above guest memory.
+// The guest fills the buffer with ordinary stores, sets the length and tag registers
+// and writes a command to the doorbell; the host then takes the whole buffer at once
+// before the next instruction runs, so the guest may refill it right away
+static constexpr Word hostIoBase = 0x40000000;
+static constexpr Word hostIoDoorbell = hostIoBase + 0x0;
+static constexpr Word hostIoLength = hostIoBase + 0x4;
+static constexpr Word hostIoTag = hostIoBase + 0x8;
+static constexpr Word hostIoBuffer = hostIoBase + 0x1000;
+static constexpr Word hostIoBufferBytes = 64 * 1024;
+static constexpr Word hostIoBytes = hostIoBuffer - hostIoBase + hostIoBufferBytes;
+
+enum class HostIoCommand : uint16_t
+{
+	// Buffer holds console output
+	Console = 1,
+	// Buffer holds 32-bit integers to print as one line of decimal numbers
+	Words = 2,
+	// Buffer holds a binary result array, identified by the tag
+	Array = 3
+};
+
+struct HostIoRequest
+{
+	HostIoCommand command;
+	Word tag;
+	std::string data;
+};
+
+class HostIoDevice
+{
+public:
+	HostIoDevice()
+			: _buffer(hostIoBufferBytes / sizeof(Word))
+	{
+	}
+
+	static bool Decodes(Word addr)
+	{
+		return addr - hostIoBase < hostIoBytes;
+	}
+
+	Word Read(Word addr) const
+	{
+		if (addr >= hostIoBuffer)
+			return _buffer[(addr - hostIoBuffer) / sizeof(Word)];
+		if (addr == hostIoDoorbell)
+			return _command;
+		if (addr == hostIoLength)
+			return _length;
+		if (addr == hostIoTag)
+			return _tag;
+		return 0;
+	}
+
+	void Write(Word addr, Word data)
+	{
+		if (addr >= hostIoBuffer)
+		{
+			_buffer[(addr - hostIoBuffer) / sizeof(Word)] = data;
+		}
+		else if (addr == hostIoDoorbell)
+		{
+			_command = data;
+			_rung = true;
+			RaiseMessageFlag();
+		}
+		else if (addr == hostIoLength)
+		{
+			_length = data;
+		}
+		else if (addr == hostIoTag)
+		{
+			_tag = data;
+		}
+	}
+
+	// A doorbell write shows up as a CpuToHostType::HostIo message carrying the command
+	std::optional<CpuToHostData> GetMessage()
+	{
+		if (!_rung)
+			return std::nullopt;
+
+		_rung = false;
+		CpuToHostData msg {};
+		msg.unpacked.data = uint16_t(_command);
+		msg.unpacked.type = CpuToHostType::HostIo;
+		return msg;
+	}
+
+	// As CsrFile::SetMessageFlag, set on every doorbell write
+	void SetMessageFlag(bool *flag)
+	{
+		_messageFlag = flag;
+	}
+
+	// Copies out the request of the last doorbell write; lengths past the end of the
+	// buffer are cut short
+	HostIoRequest Drain()
+	{
+		Word bytes = std::min(_length, hostIoBufferBytes);
+		_requests++;
+		_bytes += bytes;
+		return {HostIoCommand(_command), _tag, std::string(reinterpret_cast<const char *>(_buffer.data()), bytes)};
+	}
+
+	void RegisterStats(StatsRegistry &stats)
+	{
+		stats.AddCounter("hostio.requests", _requests);
+		stats.AddCounter("hostio.bytes", _bytes);
+	}
+
+	void Save(CheckpointWriter &cp) const
+	{
+		cp.Put(_command);
+		cp.Put(_length);
+		cp.Put(_tag);
+		cp.Put(_rung);
+		cp.Put(_requests);
+		cp.Put(_bytes);
+		cp.Write(_buffer.data(), hostIoBufferBytes);
+	}
+
+	void Restore(CheckpointReader &cp)
+	{
+		cp.Get(_command);
+		cp.Get(_length);
+		cp.Get(_tag);
+		cp.Get(_rung);
+		cp.Get(_requests);
+		cp.Get(_bytes);
+		cp.Read(_buffer.data(), hostIoBufferBytes);
+		if (_rung)
+			RaiseMessageFlag();
+	}
+
+private:
+	void RaiseMessageFlag()
+	{
+		if (_messageFlag != nullptr)
+			*_messageFlag = true;
+	}
+
+	std::vector<Word> _buffer;
+	Word _command = 0;
+	Word _length = 0;
+	Word _tag = 0;
+	bool _rung = false;
+	bool *_messageFlag = nullptr;
+
+	uint64_t _requests = 0;
+	uint64_t _bytes = 0;
+};
+
+#endif //RISCV_SIM_HOSTIODEVICE_H
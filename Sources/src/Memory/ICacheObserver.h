@@ -0,0 +1,37 @@
+#ifndef RISCV_SIM_ICACHEOBSERVER_H
+#define RISCV_SIM_ICACHEOBSERVER_H
+
+#include "../BaseTypes.h"
+
+#include <cstdint>
+
+enum class AccessKind : uint8_t
+{
+	Fetch,
+	Load,
+	Store
+};
+
+// Sees every request reaching CachedMemory, with the PC of the instruction behind it
+// and whether the real cache hit. Analyses of the address stream plug in here
+class ICacheObserver
+{
+public:
+	ICacheObserver() = default;
+
+	virtual ~ICacheObserver() = default;
+
+	ICacheObserver(const ICacheObserver &) = delete;
+
+	ICacheObserver &operator=(const ICacheObserver &) = delete;
+
+	virtual void Access(AccessKind kind, Word pc, Word addr, bool hit) = 0;
+
+	// The real cache was emptied (CachedMemory::Flush); observers that mirror its
+	// contents drop theirs
+	virtual void Flushed()
+	{
+	}
+};
+
+#endif //RISCV_SIM_ICACHEOBSERVER_H
@@ -26,6 +26,12 @@ public:
 	virtual bool Response(InstructionPtr &instr) = 0;
 
 	virtual void Clock() = 0;
+
+	// The same as `cycles` calls of Clock(), for replaying idle stretches at once
+	virtual void Clock(uint64_t cycles) = 0;
+
+	// Calls of Clock() before the current request can complete
+	virtual uint64_t BusyCycles() const = 0;
 };
 
 #endif //RISCV_SIM_IMEMORY_H
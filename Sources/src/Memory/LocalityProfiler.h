@@ -0,0 +1,198 @@
+#ifndef RISCV_SIM_LOCALITYPROFILER_H
+#define RISCV_SIM_LOCALITYPROFILER_H
+
+#include "ICacheObserver.h"
+#include "MemoryConfig.h"
+#include "StackDistance.h"
+#include "../Stats.h"
+#include "../SymbolTable.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Locality profile of the access stream of CachedMemory: reuse distances, in distinct
+// lines, of instruction fetches and data accesses, in total and per code region (the
+// function of the accessing PC, or its 4 KB page without symbols), and the number of
+// distinct lines touched in windows of a fixed number of instructions (working set size).
+// Everything is bounded by the guest memory size: the stacks hold at most one entry per
+// line, histograms are log2-bucketed, and the working set series keeps at most
+// maxPoints windows, dropping every other one and sampling half as often whenever it
+// fills up
+class LocalityProfiler : public ICacheObserver
+{
+public:
+	LocalityProfiler(const SymbolTable &symbols, Word interval)
+			: _symbols(symbols), _interval(interval), _stride(interval)
+	{
+	}
+
+	void Access(AccessKind kind, Word pc, Word addr, bool) override
+	{
+		bool fetch = kind == AccessKind::Fetch;
+		if (fetch)
+			NextInstruction();
+
+		Stream &stream = fetch ? _code : _data;
+		size_t tag = to_line_addr(addr) / line_size_bytes;
+		size_t bucket = Bucket(stream.stack.Access(tag));
+		stream.total[bucket]++;
+		stream.regions[Region(pc)][bucket]++;
+		if (_inWindow)
+			stream.window.insert(tag);
+	}
+
+	void Report(FILE *out, size_t topN)
+	{
+		if (_inWindow)
+			CloseWindow();
+		ReportStream(out, "code", _code, topN);
+		ReportStream(out, "data", _data, topN);
+
+		fprintf(out, "working set, distinct lines in %lu instructions every %lu:\n%12s %10s %10s\n",
+		        (unsigned long) _interval, (unsigned long) _stride, "instret", "code", "data");
+		for (const Point &point : _workingSet)
+			fprintf(out, "%12lu %10u %10u\n", (unsigned long) point.instret, point.codeLines, point.dataLines);
+		fprintf(out, "\n");
+	}
+
+private:
+	static constexpr size_t numBuckets = 20;
+	// Last bucket counts first references
+	static constexpr size_t coldBucket = numBuckets;
+	static constexpr size_t maxPoints = 1024;
+	using Histogram = std::array<uint64_t, numBuckets + 1>;
+
+	struct Stream
+	{
+		StackDistance stack;
+		Histogram total {};
+		std::unordered_map<Word, Histogram> regions;
+		std::unordered_set<size_t> window;
+	};
+
+	struct Point
+	{
+		uint64_t instret;
+		uint32_t codeLines;
+		uint32_t dataLines;
+	};
+
+	static size_t Bucket(uint64_t distance)
+	{
+		return distance == StackDistance::cold ? coldBucket : StatsRegistry::Log2Bucket(distance, numBuckets);
+	}
+
+	Word Region(Word pc) const
+	{
+		const SymbolTable::Symbol *sym = _symbols.Lookup(pc);
+		return sym != nullptr ? sym->addr : pc & ~Word(0xfff);
+	}
+
+	void NextInstruction()
+	{
+		if (_instructions == _nextEvent)
+		{
+			if (_inWindow)
+				CloseWindow();
+			if (_instructions == _nextWindow)
+			{
+				_inWindow = true;
+				_windowStart = _instructions;
+				_nextEvent = _instructions + _interval;
+			}
+		}
+		_instructions++;
+	}
+
+	void CloseWindow()
+	{
+		_workingSet.push_back({_windowStart, uint32_t(_code.window.size()), uint32_t(_data.window.size())});
+		_code.window.clear();
+		_data.window.clear();
+		_inWindow = false;
+		_nextWindow = _windowStart + _stride;
+		_nextEvent = _nextWindow;
+
+		if (_workingSet.size() == maxPoints)
+		{
+			for (size_t i = 0; i < maxPoints / 2; i++)
+				_workingSet[i] = _workingSet[2 * i];
+			_workingSet.resize(maxPoints / 2);
+			_stride *= 2;
+		}
+	}
+
+	static uint64_t Sum(const Histogram &histogram)
+	{
+		uint64_t sum = 0;
+		for (uint64_t count : histogram)
+			sum += count;
+		return sum;
+	}
+
+	// Share of the references with a distance below 2^(bucket - 1) lines, i.e. hits in
+	// a fully-associative LRU cache of that many lines
+	static double HitShare(const Histogram &histogram, size_t bucket)
+	{
+		uint64_t hits = 0;
+		for (size_t i = 0; i < bucket; i++)
+			hits += histogram[i];
+		uint64_t sum = Sum(histogram);
+		return sum ? 100.0 * hits / sum : 0.0;
+	}
+
+	void ReportStream(FILE *out, const char *name, const Stream &stream, size_t topN) const
+	{
+		std::vector<std::string> labels = StatsRegistry::Log2Labels(numBuckets);
+		uint64_t sum = Sum(stream.total);
+		fprintf(out, "%s reuse distance (distinct lines), %lu accesses:\n%12s %12s %8s\n", name, (unsigned long) sum,
+		        "distance", "count", "cum%");
+		uint64_t cumulative = 0;
+		for (size_t i = 0; i <= numBuckets; i++)
+		{
+			if (stream.total[i] == 0)
+				continue;
+			cumulative += stream.total[i];
+			fprintf(out, "%12s %12lu %8.2f\n", i == coldBucket ? "cold" : labels[i].c_str(),
+			        (unsigned long) stream.total[i], 100.0 * cumulative / sum);
+		}
+
+		std::vector<std::pair<Word, const Histogram *>> regions;
+		for (auto &[region, histogram] : stream.regions)
+			regions.emplace_back(region, &histogram);
+		auto top = std::min(topN, regions.size());
+		std::partial_sort(regions.begin(), regions.begin() + top, regions.end(), [](auto &a, auto &b) {
+			return Sum(*a.second) != Sum(*b.second) ? Sum(*a.second) > Sum(*b.second) : a.first < b.first;
+		});
+
+		// Columns are the hit shares in LRU caches of 16, 256 and 4096 lines
+		fprintf(out, "%12s %8s %8s %8s %8s  %s\n", "accesses", "<16", "<256", "<4096", "cold", "region");
+		for (size_t i = 0; i < top; i++)
+		{
+			const Histogram &h = *regions[i].second;
+			uint64_t total = Sum(h);
+			fprintf(out, "%12lu %8.2f %8.2f %8.2f %8.2f  %s\n", (unsigned long) total, HitShare(h, 5),
+			        HitShare(h, 9), HitShare(h, 13), 100.0 * h[coldBucket] / total,
+			        _symbols.Describe(regions[i].first).c_str());
+		}
+		fprintf(out, "\n");
+	}
+
+	const SymbolTable &_symbols;
+	const uint64_t _interval;
+	uint64_t _stride;
+	uint64_t _instructions = 0;
+	bool _inWindow = false;
+	uint64_t _windowStart = 0;
+	uint64_t _nextWindow = 0;
+	uint64_t _nextEvent = 0;
+	Stream _code;
+	Stream _data;
+	std::vector<Point> _workingSet;
+};
+
+#endif //RISCV_SIM_LOCALITYPROFILER_H
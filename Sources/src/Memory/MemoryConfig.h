@@ -16,13 +16,32 @@
 
 
 static constexpr size_t memSize = 1024 * 1024;
+static constexpr size_t memBytes = memSize * sizeof(Word);
 
 static constexpr size_t line_size_bytes = 128;
 static constexpr size_t lineSizeWords = line_size_bytes / sizeof(Word);
 using Line = std::array<Word, lineSizeWords>;
-using TagClockPair = std::pair<size_t, clock_t>;
+// LRU timestamps come from a per-cache access counter, so replacement is deterministic
+// and survives a checkpoint/restore
+using LruClock = uint64_t;
+using TagClockPair = std::pair<size_t, LruClock>;
 static constexpr size_t dataCacheBytes = 2048;
 static constexpr size_t codeCacheBytes = 1024;
+struct CacheConfig
+{
+	size_t dataBytes = dataCacheBytes;
+	size_t codeBytes = codeCacheBytes;
+};
+
+struct CacheStats
+{
+	uint64_t codeAccesses = 0;
+	uint64_t codeMisses = 0;
+	uint64_t dataAccesses = 0;
+	uint64_t dataMisses = 0;
+	uint64_t writebacks = 0;
+};
+
 static Word ToWordAddr(Word addr)
 { return addr >> 2u; }
 
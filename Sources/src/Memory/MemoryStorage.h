@@ -2,50 +2,244 @@
 #define RISCV_SIM_MEMORYSTORAGE_H
 
 #include "MemoryConfig.h"
+#include "HostIoDevice.h"
+#include "../Checkpoint.h"
+#include "../SymbolTable.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Guest memory ends below the host I/O device
+static constexpr size_t maxMemBytes = hostIoBase;
 
 class MemoryStorage
 {
 public:
 
-	MemoryStorage()
+	// `bytes` is a multiple of checkpointPageBytes, at most maxMemBytes
+	explicit MemoryStorage(size_t bytes = memBytes)
+	{
+		if (!Allocate(bytes))
+			std::abort();
+	}
+
+	~MemoryStorage()
+	{
+		munmap(_mem, _bytes);
+	}
+
+	MemoryStorage(const MemoryStorage &) = delete;
+
+	MemoryStorage &operator=(const MemoryStorage &) = delete;
+
+	size_t GetBytes() const
 	{
-		_mem.resize(memSize);
+		return _bytes;
 	}
 
 	bool LoadElf(const std::string &elf_filename)
 	{
-		std::ifstream elffile;
-		elffile.open(elf_filename, std::ios::in | std::ios::binary);
+		_symbols.Clear();
+		_text_begin = _bytes;
+		_text_end = 0;
 
-		if (!elffile.is_open())
+		int fd = open(elf_filename.c_str(), O_RDONLY);
+		if (fd < 0)
 		{
 			std::cerr << "ERROR: load_elf: failed opening file \"" << elf_filename << "\"" << std::endl;
 			return false;
 		}
 
-		elffile.seekg(0, elffile.end);
-		size_t buf_sz = elffile.tellg();
-		elffile.seekg(0, elffile.beg);
-
-		// Read the entire file. If it doesn't fit in host memory, it won't fit in the risc-v processor
-		std::vector<char> buf(buf_sz);
-		elffile.read(buf.data(), buf_sz);
-
-		if (!elffile)
+		struct stat st;
+		if (fstat(fd, &st) != 0)
 		{
 			std::cerr << "ERROR: load_elf: failed reading elf header" << std::endl;
+			close(fd);
 			return false;
 		}
+		size_t buf_sz = st.st_size;
 
 		if (buf_sz < sizeof(Elf32_Ehdr))
 		{
 			std::cerr << "ERROR: load_elf: file too small to be a valid elf file" << std::endl;
+			close(fd);
+			return false;
+		}
+
+		// Map the file read-only instead of reading it; segments are then either mapped
+		// again over guest memory or copied once from this view
+		void *buf = mmap(nullptr, buf_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (buf == MAP_FAILED)
+		{
+			std::cerr << "ERROR: load_elf: failed mapping file \"" << elf_filename << "\"" << std::endl;
+			close(fd);
+			return false;
+		}
+
+		bool loaded = LoadElfImage(fd, static_cast<char *>(buf), buf_sz);
+
+		// Segments mapped over guest memory keep their own reference to the file
+		munmap(buf, buf_sz);
+		close(fd);
+		return loaded;
+	}
+
+	// Loads an ELF image built in host memory, e.g. by ProgramGenerator
+	bool LoadElf(const std::vector<char> &image)
+	{
+		_symbols.Clear();
+		_text_begin = _bytes;
+		_text_end = 0;
+
+		if (image.size() < sizeof(Elf32_Ehdr))
+		{
+			std::cerr << "ERROR: load_elf: image too small to be a valid elf file" << std::endl;
+			return false;
+		}
+		return LoadElfImage(-1, image.data(), image.size());
+	}
+
+	// Puts the contents of a host file into guest memory at `addr`, mapped copy-on-write
+	// where the alignment allows, like an ELF segment
+	bool LoadFile(const std::string &filename, Word addr)
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0)
+		{
+			std::cerr << "ERROR: preload: failed opening file \"" << filename << "\"" << std::endl;
+			if (fd >= 0)
+				close(fd);
+			return false;
+		}
+
+		size_t size = st.st_size;
+		if (addr > _bytes || size > _bytes - addr)
+		{
+			std::cerr << "ERROR: preload: \"" << filename << "\" does not fit in guest memory at 0x"
+			          << std::hex << addr << std::dec << std::endl;
+			close(fd);
+			return false;
+		}
+
+		void *buf = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+		if (buf == MAP_FAILED)
+		{
+			std::cerr << "ERROR: preload: failed mapping file \"" << filename << "\"" << std::endl;
+			close(fd);
+			return false;
+		}
+
+		if (size > 0)
+		{
+			LoadSegment(fd, static_cast<char *>(buf), addr, 0, size);
+			munmap(buf, size);
+		}
+		close(fd);
+		return true;
+	}
+
+	Word Read(Word ip) const
+	{
+		return _mem[ToWordAddr(ip)];
+	}
+
+	void Write(Word ip, Word data)
+	{
+		_mem[ToWordAddr(ip)] = data;
+	}
+
+	// Memory models send data accesses in HostIoDevice's address range here instead
+	HostIoDevice &GetHostIo()
+	{
+		return _io;
+	}
+
+	const SymbolTable &GetSymbols() const
+	{
+		return _symbols;
+	}
+
+	// Address range of the executable segments, or all of guest memory if no ELF has
+	// been loaded (e.g. after restoring a checkpoint)
+	Word GetTextBegin() const
+	{
+		return _text_begin < _text_end ? _text_begin : 0;
+	}
+
+	Word GetTextEnd() const
+	{
+		return _text_begin < _text_end ? _text_end : _bytes;
+	}
+
+	void Save(CheckpointWriter &cp) const
+	{
+		cp.Put(uint64_t(_bytes));
+		auto memptr = reinterpret_cast<const char *>(_mem);
+		for (uint32_t page = 0; page < _bytes / checkpointPageBytes; page++)
+		{
+			const char *data = memptr + size_t(page) * checkpointPageBytes;
+			auto words = reinterpret_cast<const Word *>(data);
+			if (std::all_of(words, words + checkpointPageBytes / sizeof(Word), [](Word w) { return w == 0; }))
+				continue;
+
+			cp.Put(page);
+			cp.Write(data, checkpointPageBytes);
+		}
+		cp.Put(checkpointEndOfPages);
+		_io.Save(cp);
+	}
+
+	bool Restore(CheckpointReader &cp)
+	{
+		auto bytes = cp.Get<uint64_t>();
+		if (!cp.Ok() || bytes == 0 || bytes % checkpointPageBytes != 0 || bytes > maxMemBytes)
+		{
+			std::cerr << "ERROR: restore: invalid guest memory size " << bytes << std::endl;
+			return false;
+		}
+		// A fresh mapping of the saved size drops both dirty pages and pages mapped from an ELF
+		if (!Allocate(bytes))
+			return false;
+
+		auto memptr = reinterpret_cast<char *>(_mem);
+		for (uint32_t page = cp.Get<uint32_t>(); page != checkpointEndOfPages && cp.Ok(); page = cp.Get<uint32_t>())
+		{
+			if (page >= _bytes / checkpointPageBytes)
+			{
+				std::cerr << "ERROR: restore: page " << page << " is outside of guest memory" << std::endl;
+				return false;
+			}
+			cp.Read(memptr + size_t(page) * checkpointPageBytes, checkpointPageBytes);
+		}
+		_io.Restore(cp);
+		return cp.Ok();
+	}
+
+private:
+	// Maps `bytes` of zeroed guest memory in place of the current mapping, if any
+	bool Allocate(size_t bytes)
+	{
+		void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED)
+		{
+			std::cerr << "ERROR: failed allocating " << bytes << " bytes of guest memory" << std::endl;
 			return false;
 		}
+		if (_mem != nullptr)
+			munmap(_mem, _bytes);
+		_mem = static_cast<Word *>(mem);
+		_bytes = bytes;
+		return true;
+	}
 
+	bool LoadElfImage(int fd, const char *buf, size_t buf_sz)
+	{
 		// make sure the header matches elf32 or elf64
-		Elf32_Ehdr *ehdr = (Elf32_Ehdr *) buf.data();
-		unsigned char *e_ident = ehdr->e_ident;
+		const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *) buf;
+		const unsigned char *e_ident = ehdr->e_ident;
 		if (e_ident[EI_MAG0] != ELFMAG0
 		    || e_ident[EI_MAG1] != ELFMAG1
 		    || e_ident[EI_MAG2] != ELFMAG2
@@ -58,11 +252,11 @@ public:
 		if (e_ident[EI_CLASS] == ELFCLASS32)
 		{
 			// 32-bit ELF
-			return this->LoadElfSpecific<Elf32_Ehdr, Elf32_Phdr>(buf.data(), buf_sz);
+			return this->LoadElfSpecific<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Sym>(fd, buf, buf_sz);
 		} else if (e_ident[EI_CLASS] == ELFCLASS64)
 		{
 			// 64-bit ELF
-			return this->LoadElfSpecific<Elf64_Ehdr, Elf64_Phdr>(buf.data(), buf_sz);
+			return this->LoadElfSpecific<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Sym>(fd, buf, buf_sz);
 		} else
 		{
 			std::cerr << "ERROR: load_elf: file is neither 32-bit nor 64-bit" << std::endl;
@@ -70,29 +264,18 @@ public:
 		}
 	}
 
-	Word Read(Word ip)
-	{
-		return _mem[ToWordAddr(ip)];
-	}
-
-	void Write(Word ip, Word data)
-	{
-		_mem[ToWordAddr(ip)] = data;
-	}
-
-private:
-	template<typename Elf_Ehdr, typename Elf_Phdr>
-	bool LoadElfSpecific(char *buf, size_t buf_sz)
+	template<typename Elf_Ehdr, typename Elf_Phdr, typename Elf_Shdr, typename Elf_Sym>
+	bool LoadElfSpecific(int fd, const char *buf, size_t buf_sz)
 	{
 		// 64-bit ELF
-		Elf_Ehdr *ehdr = (Elf_Ehdr *) buf;
-		Elf_Phdr *phdr = (Elf_Phdr *) (buf + ehdr->e_phoff);
+		const Elf_Ehdr *ehdr = (const Elf_Ehdr *) buf;
+		const Elf_Phdr *phdr = (const Elf_Phdr *) (buf + ehdr->e_phoff);
 		if (buf_sz < ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf_Phdr))
 		{
 			std::cerr << "ERROR: load_elf: file too small for expected number of program header tables" << std::endl;
 			return false;
 		}
-		auto memptr = reinterpret_cast<char *>(_mem.data());
+		auto memptr = reinterpret_cast<char *>(_mem);
 		// loop through program header tables
 		for (int i = 0; i < ehdr->e_phnum; i++)
 		{
@@ -103,6 +286,11 @@ private:
 					std::cerr << "ERROR: load_elf: file size is larger than memory size" << std::endl;
 					return false;
 				}
+				if (phdr[i].p_paddr + phdr[i].p_memsz > _bytes)
+				{
+					std::cerr << "ERROR: load_elf: segment does not fit in guest memory" << std::endl;
+					return false;
+				}
 				if (phdr[i].p_filesz > 0)
 				{
 					if (phdr[i].p_offset + phdr[i].p_filesz > buf_sz)
@@ -114,7 +302,7 @@ private:
 					// start of file section: buf + phdr[i].p_offset
 					// end of file section: buf + phdr[i].p_offset + phdr[i].p_filesz
 					// start of memory: phdr[i].p_paddr
-					memcpy(memptr + phdr[i].p_paddr, buf + phdr[i].p_offset, phdr[i].p_filesz);
+					LoadSegment(fd, buf, phdr[i].p_paddr, phdr[i].p_offset, phdr[i].p_filesz);
 				}
 				if (phdr[i].p_memsz > phdr[i].p_filesz)
 				{
@@ -122,12 +310,89 @@ private:
 					size_t zeros_sz = phdr[i].p_memsz - phdr[i].p_filesz;
 					memset(memptr + phdr[i].p_paddr + phdr[i].p_filesz, 0, zeros_sz);
 				}
+				if (phdr[i].p_flags & PF_X)
+				{
+					_text_begin = std::min<Word>(_text_begin, phdr[i].p_paddr);
+					_text_end = std::max<Word>(_text_end, phdr[i].p_paddr + phdr[i].p_memsz);
+				}
 			}
 		}
+
+		LoadSymbols<Elf_Ehdr, Elf_Shdr, Elf_Sym>(buf, buf_sz);
 		return true;
 	}
 
-	std::__1::vector<Word> _mem;
+	// Collects code symbols from .symtab; a missing or malformed table only means
+	// there are no names to report, so nothing here fails the load
+	template<typename Elf_Ehdr, typename Elf_Shdr, typename Elf_Sym>
+	void LoadSymbols(const char *buf, size_t buf_sz)
+	{
+		const Elf_Ehdr *ehdr = (const Elf_Ehdr *) buf;
+		if (ehdr->e_shoff == 0 || buf_sz < ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf_Shdr))
+			return;
+
+		const Elf_Shdr *shdr = (const Elf_Shdr *) (buf + ehdr->e_shoff);
+		for (int i = 0; i < ehdr->e_shnum; i++)
+		{
+			if (shdr[i].sh_type != SHT_SYMTAB || shdr[i].sh_link >= ehdr->e_shnum)
+				continue;
+
+			const Elf_Shdr &strtab = shdr[shdr[i].sh_link];
+			if (shdr[i].sh_offset + shdr[i].sh_size > buf_sz || strtab.sh_offset + strtab.sh_size > buf_sz)
+				continue;
+
+			const Elf_Sym *sym = (const Elf_Sym *) (buf + shdr[i].sh_offset);
+			size_t count = shdr[i].sh_size / sizeof(Elf_Sym);
+			for (size_t s = 0; s < count; s++)
+			{
+				auto type = ELF32_ST_TYPE(sym[s].st_info);
+				if ((type != STT_FUNC && type != STT_NOTYPE)
+				    || sym[s].st_shndx == SHN_UNDEF || sym[s].st_shndx >= ehdr->e_shnum
+				    || !(shdr[sym[s].st_shndx].sh_flags & SHF_EXECINSTR)
+				    || sym[s].st_name >= strtab.sh_size)
+					continue;
+
+				const char *name = buf + strtab.sh_offset + sym[s].st_name;
+				_symbols.Add(std::string(name, strnlen(name, strtab.sh_size - sym[s].st_name)),
+				             sym[s].st_value, sym[s].st_size);
+			}
+		}
+	}
+
+	// Pages of the segment that are fully covered by file data and share the file's
+	// page alignment are mapped copy-on-write over guest memory, the misaligned head
+	// and tail (or the whole segment, if mapping is impossible or there is no file
+	// behind `buf`, fd < 0) are copied
+	void LoadSegment(int fd, const char *buf, size_t paddr, size_t offset, size_t filesz)
+	{
+		auto memptr = reinterpret_cast<char *>(_mem);
+		const size_t page = sysconf(_SC_PAGESIZE);
+		size_t mapped_begin = 0;
+		size_t mapped_end = 0;
+
+		if (fd >= 0 && paddr % page == offset % page)
+		{
+			mapped_begin = (paddr + page - 1) / page * page - paddr;
+			mapped_end = (paddr + filesz) / page * page - paddr;
+			if (mapped_begin >= mapped_end
+			    || mmap(memptr + paddr + mapped_begin, mapped_end - mapped_begin, PROT_READ | PROT_WRITE,
+			            MAP_PRIVATE | MAP_FIXED, fd, offset + mapped_begin) == MAP_FAILED)
+			{
+				mapped_begin = 0;
+				mapped_end = 0;
+			}
+		}
+
+		memcpy(memptr + paddr, buf + offset, mapped_begin);
+		memcpy(memptr + paddr + mapped_end, buf + offset + mapped_end, filesz - mapped_end);
+	}
+
+	Word *_mem = nullptr;
+	size_t _bytes = 0;
+	HostIoDevice _io;
+	SymbolTable _symbols;
+	Word _text_begin = 0;
+	Word _text_end = 0;
 };
 
 #endif //RISCV_SIM_MEMORYSTORAGE_H
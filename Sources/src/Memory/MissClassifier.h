@@ -0,0 +1,155 @@
+#ifndef RISCV_SIM_MISSCLASSIFIER_H
+#define RISCV_SIM_MISSCLASSIFIER_H
+
+#include "ICacheObserver.h"
+#include "MemoryConfig.h"
+#include "../SymbolTable.h"
+
+#include <cstdio>
+#include <initializer_list>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// 3C classification of the misses of CachedMemory. Every access also goes through two
+// shadow caches per side (code and data): an infinite one, where a miss means the line
+// was never touched before (compulsory), and a fully-associative LRU cache of the real
+// capacity, where a miss that is not compulsory means the working set did not fit
+// (capacity). Real misses that hit in the fully-associative shadow are conflict misses
+class MissClassifier : public ICacheObserver
+{
+public:
+	explicit MissClassifier(const CacheConfig &config)
+			: _code(config.codeBytes / line_size_bytes), _data(config.dataBytes / line_size_bytes)
+	{
+	}
+
+	void Access(AccessKind kind, Word pc, Word addr, bool hit) override
+	{
+		Side &side = kind == AccessKind::Fetch ? _code : _data;
+		size_t tag = to_line_addr(addr) / line_size_bytes;
+		bool seen = !side.seen.insert(tag).second;
+		bool shadowHit = side.lru.Access(tag);
+		if (hit)
+			return;
+
+		MissClass missClass = !seen ? Compulsory : shadowHit ? Conflict : Capacity;
+		side.total[missClass]++;
+		side.perPc[pc][missClass]++;
+	}
+
+	// Lines touched before a flush miss again, which makes them compulsory misses of the
+	// now empty cache rather than conflict misses
+	void Flushed() override
+	{
+		for (Side *side : {&_code, &_data})
+		{
+			side->seen.clear();
+			side->lru.Clear();
+		}
+	}
+
+	void Report(FILE *out, const SymbolTable &symbols, size_t topN) const
+	{
+		ReportSide(out, "code", _code, symbols, topN);
+		ReportSide(out, "data", _data, symbols, topN);
+	}
+
+private:
+	enum MissClass
+	{
+		Compulsory,
+		Capacity,
+		Conflict,
+		NumMissClasses
+	};
+	using Counts = std::array<uint64_t, NumMissClasses>;
+
+	class LruShadow
+	{
+	public:
+		explicit LruShadow(size_t lines)
+				: _lines(lines)
+		{
+		}
+
+		// Returns true on a hit; the line becomes most recently used either way
+		bool Access(size_t tag)
+		{
+			auto found = _where.find(tag);
+			if (found != _where.end())
+			{
+				_order.splice(_order.begin(), _order, found->second);
+				return true;
+			}
+
+			if (_order.size() >= _lines)
+			{
+				_where.erase(_order.back());
+				_order.pop_back();
+			}
+			_order.push_front(tag);
+			_where[tag] = _order.begin();
+			return false;
+		}
+
+		void Clear()
+		{
+			_order.clear();
+			_where.clear();
+		}
+
+	private:
+		size_t _lines;
+		std::list<size_t> _order;
+		std::unordered_map<size_t, std::list<size_t>::iterator> _where;
+	};
+
+	struct Side
+	{
+		explicit Side(size_t lines)
+				: lru(lines)
+		{
+		}
+
+		std::unordered_set<size_t> seen;
+		LruShadow lru;
+		Counts total {};
+		std::unordered_map<Word, Counts> perPc;
+	};
+
+	static uint64_t Sum(const Counts &counts)
+	{
+		return counts[Compulsory] + counts[Capacity] + counts[Conflict];
+	}
+
+	static void ReportSide(FILE *out, const char *name, const Side &side, const SymbolTable &symbols, size_t topN)
+	{
+		fprintf(out, "%s misses: %lu (compulsory %lu, capacity %lu, conflict %lu)\n", name,
+		        (unsigned long) Sum(side.total), (unsigned long) side.total[Compulsory],
+		        (unsigned long) side.total[Capacity], (unsigned long) side.total[Conflict]);
+
+		std::vector<std::pair<Word, Counts>> byPc(side.perPc.begin(), side.perPc.end());
+		auto top = std::min(topN, byPc.size());
+		std::partial_sort(byPc.begin(), byPc.begin() + top, byPc.end(), [](auto &a, auto &b) {
+			return Sum(a.second) != Sum(b.second) ? Sum(a.second) > Sum(b.second) : a.first < b.first;
+		});
+
+		fprintf(out, "%10s %10s %10s %10s  %-10s  %s\n", "misses", "compulsory", "capacity", "conflict", "pc",
+		        "location");
+		for (size_t i = 0; i < top; i++)
+		{
+			const Counts &c = byPc[i].second;
+			fprintf(out, "%10lu %10lu %10lu %10lu  0x%08x  %s\n", (unsigned long) Sum(c),
+			        (unsigned long) c[Compulsory], (unsigned long) c[Capacity], (unsigned long) c[Conflict],
+			        byPc[i].first, symbols.Describe(byPc[i].first).c_str());
+		}
+		fprintf(out, "\n");
+	}
+
+	Side _code;
+	Side _data;
+};
+
+#endif //RISCV_SIM_MISSCLASSIFIER_H
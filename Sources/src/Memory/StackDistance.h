@@ -0,0 +1,183 @@
+#ifndef RISCV_SIM_STACKDISTANCE_H
+#define RISCV_SIM_STACKDISTANCE_H
+
+#include "ICacheObserver.h"
+#include "MemoryConfig.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+// Mattson stack distances of one stream of line tags: the number of distinct other
+// lines referenced since the previous reference to the same line, so a reference hits
+// in an LRU cache of L lines exactly when its distance is below L. The most recent
+// reference time of every line is marked in a Fenwick tree, which makes each access
+// O(log n); times are renumbered densely whenever the tree fills up
+class StackDistance
+{
+public:
+	static constexpr uint64_t cold = ~uint64_t(0);
+
+	uint64_t Access(size_t tag)
+	{
+		if (_now == _tree.size())
+			Compact();
+
+		uint64_t distance = cold;
+		auto found = _last.find(tag);
+		if (found != _last.end())
+		{
+			distance = _live - Prefix(found->second);
+			Add(found->second, -1);
+			found->second = _now;
+		}
+		else
+		{
+			_live++;
+			_last.emplace(tag, _now);
+		}
+		Add(_now, 1);
+		_now++;
+		return distance;
+	}
+
+	size_t DistinctLines() const
+	{
+		return _live;
+	}
+
+private:
+	static constexpr size_t minTimes = 1024;
+
+	// Number of marks at times 0..time
+	int64_t Prefix(size_t time) const
+	{
+		int64_t sum = 0;
+		for (size_t i = time + 1; i > 0; i -= i & -i)
+			sum += _tree[i - 1];
+		return sum;
+	}
+
+	void Add(size_t time, int32_t delta)
+	{
+		for (size_t i = time + 1; i <= _tree.size(); i += i & -i)
+			_tree[i - 1] += delta;
+	}
+
+	void Compact()
+	{
+		std::vector<std::pair<size_t, size_t>> byTime;
+		byTime.reserve(_last.size());
+		for (auto &[tag, time] : _last)
+			byTime.emplace_back(time, tag);
+		std::sort(byTime.begin(), byTime.end());
+
+		_tree.assign(std::max(2 * byTime.size(), minTimes), 0);
+		for (size_t i = 0; i < byTime.size(); i++)
+		{
+			_last[byTime[i].second] = i;
+			Add(i, 1);
+		}
+		_now = byTime.size();
+	}
+
+	std::unordered_map<size_t, size_t> _last;
+	std::vector<int32_t> _tree;
+	size_t _now = 0;
+	size_t _live = 0;
+};
+
+// Miss-rate curves of the code and data streams for every cache size in a single run:
+// fully associative caches of any number of lines, and caches of a fixed number of sets
+// with any associativity (one stack per set)
+class StackDistanceProfiler : public ICacheObserver
+{
+public:
+	explicit StackDistanceProfiler(size_t sets)
+			: _code(sets), _data(sets)
+	{
+	}
+
+	void Access(AccessKind kind, Word, Word addr, bool) override
+	{
+		Stream &stream = kind == AccessKind::Fetch ? _code : _data;
+		size_t tag = to_line_addr(addr) / line_size_bytes;
+		stream.accesses++;
+		Record(stream.fullyAssociative, stream.fullyAssociativeStack.Access(tag));
+		Record(stream.setAssociative, stream.setStacks[tag % stream.setStacks.size()].Access(tag));
+	}
+
+	void Report(FILE *out) const
+	{
+		ReportStream(out, "code", _code);
+		ReportStream(out, "data", _data);
+	}
+
+private:
+	struct Stream
+	{
+		explicit Stream(size_t sets)
+				: setStacks(sets)
+		{
+		}
+
+		uint64_t accesses = 0;
+		StackDistance fullyAssociativeStack;
+		std::vector<StackDistance> setStacks;
+		// Histograms of finite distances; cold references are accesses minus their sum
+		std::vector<uint64_t> fullyAssociative;
+		std::vector<uint64_t> setAssociative;
+	};
+
+	static void Record(std::vector<uint64_t> &histogram, uint64_t distance)
+	{
+		if (distance == StackDistance::cold)
+			return;
+		if (distance >= histogram.size())
+			histogram.resize(distance + 1);
+		histogram[distance]++;
+	}
+
+	// Misses of an LRU cache (or set) of `lines` lines
+	static uint64_t Misses(const Stream &stream, const std::vector<uint64_t> &histogram, size_t lines)
+	{
+		uint64_t hits = 0;
+		for (size_t d = 0; d < lines && d < histogram.size(); d++)
+			hits += histogram[d];
+		return stream.accesses - hits;
+	}
+
+	static void ReportStream(FILE *out, const char *name, const Stream &stream)
+	{
+		size_t sets = stream.setStacks.size();
+		fprintf(out, "%s: %lu accesses, %zu distinct lines\n", name, (unsigned long) stream.accesses,
+		        stream.fullyAssociativeStack.DistinctLines());
+
+		fprintf(out, "fully associative:\n%12s %8s %12s %10s\n", "bytes", "lines", "misses", "miss_rate");
+		for (size_t lines = 1; ; lines *= 2)
+		{
+			uint64_t misses = Misses(stream, stream.fullyAssociative, lines);
+			fprintf(out, "%12zu %8zu %12lu %10.6f\n", lines * line_size_bytes, lines, (unsigned long) misses,
+			        stream.accesses ? double(misses) / stream.accesses : 0.0);
+			if (lines >= stream.fullyAssociative.size())
+				break;
+		}
+
+		fprintf(out, "%zu sets:\n%12s %8s %12s %10s\n", sets, "bytes", "ways", "misses", "miss_rate");
+		for (size_t ways = 1; ; ways *= 2)
+		{
+			uint64_t misses = Misses(stream, stream.setAssociative, ways);
+			fprintf(out, "%12zu %8zu %12lu %10.6f\n", sets * ways * line_size_bytes, ways, (unsigned long) misses,
+			        stream.accesses ? double(misses) / stream.accesses : 0.0);
+			if (ways >= stream.setAssociative.size())
+				break;
+		}
+		fprintf(out, "\n");
+	}
+
+	Stream _code;
+	Stream _data;
+};
+
+#endif //RISCV_SIM_STACKDISTANCE_H
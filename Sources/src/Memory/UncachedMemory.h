@@ -3,8 +3,9 @@
 
 #include "IMemory.h"
 #include "MemoryStorage.h"
+#include "../Stats.h"
 
-class UncachedMemory : public IMemory
+class UncachedMemory final : public IMemory
 {
 public:
 	explicit UncachedMemory(MemoryStorage &amem)
@@ -17,6 +18,7 @@ public:
 	{
 		_requestedIp = ip;
 		_waitCycles = latency;
+		_fetches++;
 	}
 
 	std::__1::optional<Word> Response()
@@ -32,7 +34,12 @@ public:
 		if (instr->_type != IType::Ld && instr->_type != IType::St)
 			return;
 
-		Request(instr->_addr);
+		_requestedIp = instr->_addr;
+		_waitCycles = HostIoDevice::Decodes(instr->_addr) ? hostIoLatency : latency;
+		if (instr->_type == IType::Ld)
+			_loads++;
+		else
+			_stores++;
 	}
 
 	bool Response(InstructionPtr &instr)
@@ -43,11 +50,7 @@ public:
 		if (_waitCycles != 0)
 			return false;
 
-		if (instr->_type == IType::Ld)
-			instr->_data = _mem.Read(instr->_addr);
-		else if (instr->_type == IType::St)
-			_mem.Write(instr->_addr, instr->_data);
-
+		Access(instr);
 		return true;
 	}
 
@@ -57,12 +60,86 @@ public:
 			--_waitCycles;
 	}
 
+	void Clock(uint64_t cycles)
+	{
+		_waitCycles -= std::min<uint64_t>(cycles, _waitCycles);
+	}
+
+	uint64_t BusyCycles() const
+	{
+		return _waitCycles;
+	}
+
+	// Untimed accesses for functional simulation; there is no cache to warm or flush
+	Word FetchFunctional(Word ip, bool)
+	{
+		return _mem.Read(ip);
+	}
+
+	void AccessFunctional(InstructionPtr &instr, bool)
+	{
+		if (instr->_type == IType::Ld || instr->_type == IType::St)
+			Access(instr);
+	}
+
+	void Flush()
+	{
+	}
+
+	HostIoDevice &GetHostIo()
+	{
+		return _mem.GetHostIo();
+	}
+
+	Word Peek(Word ip) const
+	{
+		return _mem.Read(ip);
+	}
+
+	Word PeekData(Word addr) const
+	{
+		return _mem.Read(addr);
+	}
+
+	// In cache terms every access misses, which is what the profiler attributes to
+	// each instruction
+	CacheStats GetStats() const
+	{
+		return {_fetches, _fetches, _loads + _stores, _loads + _stores, 0};
+	}
+
+	void RegisterStats(StatsRegistry &stats)
+	{
+		_mem.GetHostIo().RegisterStats(stats);
+		stats.AddCounter("memory.fetches", _fetches);
+		stats.AddCounter("memory.loads", _loads);
+		stats.AddCounter("memory.stores", _stores);
+	}
+
 
 private:
+	// Performs the load or store of `instr` on memory or the host I/O device
+	void Access(InstructionPtr &instr)
+	{
+		HostIoDevice &io = _mem.GetHostIo();
+		bool device = HostIoDevice::Decodes(instr->_addr);
+		if (instr->_type == IType::Ld)
+			instr->_data = device ? io.Read(instr->_addr) : _mem.Read(instr->_addr);
+		else if (device)
+			io.Write(instr->_addr, instr->_data);
+		else
+			_mem.Write(instr->_addr, instr->_data);
+	}
+
 	static constexpr size_t latency = 120;
+	static constexpr size_t hostIoLatency = 1;
 	Word _requestedIp = 0;
 	size_t _waitCycles = 0;
 	MemoryStorage &_mem;
+
+	uint64_t _fetches = 0;
+	uint64_t _loads = 0;
+	uint64_t _stores = 0;
 };
 
 #endif //RISCV_SIM_UNCACHEDMEMORY_H
@@ -0,0 +1,545 @@
+#ifndef RISCV_SIM_OPTIONS_H
+#define RISCV_SIM_OPTIONS_H
+
+#include "BaseTypes.h"
+#include "Marker.h"
+#include "Sampling.h"
+#include "Stats.h"
+#include "Memory/MemoryConfig.h"
+#include "Memory/MemoryStorage.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A host file and the range of guest memory it is loaded into or dumped from
+struct MemoryFile
+{
+	std::string file;
+	Word addr = 0;
+	Word bytes = 0;
+};
+
+struct Options
+{
+	std::string program = "program";
+	std::string generateSpec;
+	std::string generateOut;
+	bool uncached = false;
+	size_t guestMemoryBytes = memBytes;
+
+	std::string checkpointFile;
+	Marker checkpointAt {Marker::Kind::Instret, 0};
+	std::string restoreFile;
+
+	std::vector<MemoryFile> preloads;
+	std::vector<MemoryFile> memoryDumps;
+
+	Marker fastForwardTo;
+	Marker warmFrom;
+
+	Marker sweepAt;
+	std::vector<CacheConfig> sweepConfigs;
+
+	std::string guestOutputFile;
+	std::string resultArrayPrefix;
+
+	std::string statsFile;
+	StatsRegistry::Format statsFormat = StatsRegistry::Format::Json;
+
+	bool profile = false;
+	size_t profileTop = 10;
+	std::string callGraphFile;
+	std::string traceFile;
+	bool traceCompress = true;
+	std::string tracePrintFile;
+	bool hostProfile = false;
+	double progressSeconds = 0;
+	uint64_t maxCycles = 0;
+	double timeoutSeconds = 0;
+	std::string captureFile;
+	std::string replayFile;
+	bool replayUncached = false;
+	CacheConfig replayCache;
+	bool missClasses = false;
+	bool stackDistance = false;
+	Word stackDistanceSets = 4;
+	bool locality = false;
+	Word localityInterval = 100000;
+
+	bool sample = false;
+	SampleConfig sampleConfig;
+};
+
+static void PrintUsage(const char *argv0)
+{
+	fprintf(stderr,
+	        "Usage: %s [options] [program]\n"
+	        "  program                  ELF to run (default: ./program)\n"
+	        "  --generate SPEC          run a generated self-checking program instead of an ELF\n"
+	        "  --generate-out FILE      write the --generate program to FILE as an ELF and exit\n"
+	        "  --memory MODEL           cached (default) or uncached memory model\n"
+	        "  --guest-memory BYTES     guest memory size, a multiple of 4096 from 4 MiB (the default)\n"
+	        "                           up to 1 GiB\n"
+	        "  --guest-output FILE      write guest console output to FILE instead of stderr\n"
+	        "  --result-arrays PREFIX   write arrays the guest sends through host I/O to PREFIX<tag>.bin\n"
+	        "  --stats FILE             dump statistics to FILE (\"-\" for stdout) at exit\n"
+	        "  --stats-format FORMAT    json (default) or csv\n"
+	        "  --profile                report the guest functions and instructions taking most cycles\n"
+	        "  --profile-top N          number of entries in each profile table (default: 10)\n"
+	        "  --miss-classes           classify cache misses as compulsory, capacity or conflict\n"
+	        "  --stack-distance         report miss rates of every cache size from one run\n"
+	        "  --stack-sets N           set count of the set-associative curves (default: 4)\n"
+	        "  --locality               report reuse distances and working set sizes\n"
+	        "  --locality-interval N    instructions per working set sample (default: 100000)\n"
+	        "  --callgraph FILE         write cycles per guest call stack to FILE as folded stacks\n"
+	        "  --host-profile           report simulation speed and host time per CPU component\n"
+	        "  --progress SECONDS       print a progress line every SECONDS of host time\n"
+	        "  --max-cycles N           end the run after N simulated cycles (exit status 124)\n"
+	        "  --timeout SECONDS        end the run after SECONDS of host time (exit status 124)\n"
+	        "  --trace FILE             write a binary trace of every retired instruction to FILE\n"
+	        "  --trace-compress MODE    zlib (default) or none\n"
+	        "  --trace-print FILE       print a trace written by --trace as text and exit\n"
+	        "  --capture-accesses FILE  record the requests reaching the cache, with their timing, to FILE\n"
+	        "  --replay FILE            replay a recorded access stream instead of running a program\n"
+	        "  --replay-memory MODEL    cached (default) or uncached memory model for --replay\n"
+	        "  --replay-cache DATA:CODE cache bytes of the cached model for --replay\n"
+	        "  --fast-forward MARKER    execute untimed up to MARKER, then switch to the timing model\n"
+	        "  --warm-from MARKER       keep caches warm during fast-forward from MARKER on\n"
+	        "  --checkpoint FILE        save a checkpoint to FILE ...\n"
+	        "  --checkpoint-at MARKER   ... on reaching MARKER (default: instret:0)\n"
+	        "  --restore FILE           resume from a checkpoint instead of loading program\n"
+	        "  --preload FILE@ADDR      load FILE into guest memory at ADDR before reset\n"
+	        "  --dump-memory ADDR:BYTES@FILE\n"
+	        "                           write BYTES of guest memory from ADDR to FILE at exit\n"
+	        "  --sweep-at MARKER        run to MARKER, then fork one child per --sweep configuration\n"
+	        "  --sweep DATA:CODE        data and code cache bytes of one sweep configuration\n"
+	        "  --sample                 estimate CPI by sampling, rerunning until the error target is met\n"
+	        "  --sample-period N        instructions between sample starts (default: 10000)\n"
+	        "  --sample-warmup N        detailed instructions before each window (default: 2000)\n"
+	        "  --sample-window N        measured instructions per sample (default: 1000)\n"
+	        "  --sample-error E         target relative 95%% confidence half-width (default: 0.03)\n"
+	        "\n"
+	        "MARKER is pc:ADDR, instret:N, tohost:TAG (a mtohost Marker message) or cycle-read\n"
+	        "(the next csrr of the cycle CSR); a bare number is an instret count\n"
+	        "\n"
+	        "A guest stuck in a jump or branch to itself that changes no register ends the run\n"
+	        "with exit status 125\n"
+	        "\n"
+	        "SPEC is NAME[:KEY=VALUE,...], NAME and KEYs being one of\n"
+	        "  chase   pointer chase: footprint (bytes), node (bytes per node), steps, seed\n"
+	        "  stream  strided read-modify-write: footprint (bytes), stride (bytes), passes\n"
+	        "  branch  data-dependent branch: iterations, taken (percent), seed\n"
+	        "  calls   nested call chain: depth, calls\n"
+	        "  deps    dependent ALU operations: length, chains, iterations\n",
+	        argv0);
+}
+
+static bool ParseNumber(const char *str, uint64_t &value)
+{
+	char *end = nullptr;
+	errno = 0;
+	unsigned long long parsed = strtoull(str, &end, 0);
+	if (*str == '\0' || *end != '\0' || errno == ERANGE)
+		return false;
+	value = parsed;
+	return true;
+}
+
+static bool ParseNumber(const char *str, Word &value)
+{
+	uint64_t parsed = 0;
+	if (!ParseNumber(str, parsed) || parsed > 0xffffffffull)
+		return false;
+	value = Word(parsed);
+	return true;
+}
+
+static bool ParseMarker(const char *str, Marker &marker)
+{
+	std::string s = str;
+	if (s == "cycle-read")
+	{
+		marker.kind = Marker::Kind::CycleRead;
+		marker.value = 0;
+		return true;
+	}
+
+	size_t colon = s.find(':');
+	std::string kind = colon == std::string::npos ? "instret" : s.substr(0, colon);
+	std::string value = colon == std::string::npos ? s : s.substr(colon + 1);
+
+	if (kind == "pc")
+		marker.kind = Marker::Kind::Pc;
+	else if (kind == "instret")
+		marker.kind = Marker::Kind::Instret;
+	else if (kind == "tohost")
+		marker.kind = Marker::Kind::ToHost;
+	else
+		return false;
+
+	// Instruction counts are 64-bit, addresses and tags fit in a Word
+	if (marker.kind == Marker::Kind::Instret)
+		return ParseNumber(value.c_str(), marker.value);
+	Word word = 0;
+	bool ok = ParseNumber(value.c_str(), word);
+	marker.value = word;
+	return ok;
+}
+
+static bool ParseCacheConfig(const char *str, CacheConfig &config)
+{
+	std::string s = str;
+	size_t colon = s.find(':');
+	Word dataBytes = 0;
+	Word codeBytes = 0;
+	if (colon == std::string::npos
+	    || !ParseNumber(s.substr(0, colon).c_str(), dataBytes)
+	    || !ParseNumber(s.substr(colon + 1).c_str(), codeBytes))
+		return false;
+
+	// Both caches must hold at least one whole line
+	if (dataBytes < line_size_bytes || dataBytes % line_size_bytes != 0
+	    || codeBytes < line_size_bytes || codeBytes % line_size_bytes != 0)
+		return false;
+
+	config.dataBytes = dataBytes;
+	config.codeBytes = codeBytes;
+	return true;
+}
+
+// FILE@ADDR
+static bool ParsePreload(const char *str, MemoryFile &preload)
+{
+	std::string s = str;
+	size_t at = s.rfind('@');
+	if (at == std::string::npos || at == 0 || !ParseNumber(s.substr(at + 1).c_str(), preload.addr))
+		return false;
+	preload.file = s.substr(0, at);
+	return true;
+}
+
+// ADDR:BYTES@FILE, a word aligned range; DumpMemory checks that it lies within guest memory
+static bool ParseMemoryDump(const char *str, MemoryFile &dump)
+{
+	std::string s = str;
+	size_t colon = s.find(':');
+	size_t at = s.find('@');
+	if (colon == std::string::npos || at == std::string::npos || colon > at || at + 1 == s.size()
+	    || !ParseNumber(s.substr(0, colon).c_str(), dump.addr)
+	    || !ParseNumber(s.substr(colon + 1, at - colon - 1).c_str(), dump.bytes))
+		return false;
+	dump.file = s.substr(at + 1);
+	return dump.addr % sizeof(Word) == 0 && dump.bytes % sizeof(Word) == 0;
+}
+
+static bool ParseOptions(int argc, char **argv, Options &opts)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool ok = true;
+
+		if (arg == "-h" || arg == "--help")
+		{
+			PrintUsage(argv[0]);
+			exit(0);
+		}
+		else if (arg == "--generate" && value)
+		{
+			opts.generateSpec = value;
+			i++;
+		}
+		else if (arg == "--generate-out" && value)
+		{
+			opts.generateOut = value;
+			i++;
+		}
+		else if (arg == "--guest-output" && value)
+		{
+			opts.guestOutputFile = value;
+			i++;
+		}
+		else if (arg == "--result-arrays" && value)
+		{
+			opts.resultArrayPrefix = value;
+			i++;
+		}
+		else if (arg == "--stats" && value)
+		{
+			opts.statsFile = value;
+			i++;
+		}
+		else if (arg == "--stats-format" && value)
+		{
+			std::string format = value;
+			ok = format == "json" || format == "csv";
+			opts.statsFormat = format == "csv" ? StatsRegistry::Format::Csv : StatsRegistry::Format::Json;
+			i++;
+		}
+		else if (arg == "--profile")
+		{
+			opts.profile = true;
+		}
+		else if (arg == "--profile-top" && value)
+		{
+			Word top = 0;
+			ok = ParseNumber(value, top);
+			opts.profileTop = top;
+			i++;
+		}
+		else if (arg == "--miss-classes")
+		{
+			opts.missClasses = true;
+		}
+		else if (arg == "--stack-distance")
+		{
+			opts.stackDistance = true;
+		}
+		else if (arg == "--stack-sets" && value)
+		{
+			ok = ParseNumber(value, opts.stackDistanceSets) && opts.stackDistanceSets > 0;
+			i++;
+		}
+		else if (arg == "--locality")
+		{
+			opts.locality = true;
+		}
+		else if (arg == "--locality-interval" && value)
+		{
+			ok = ParseNumber(value, opts.localityInterval) && opts.localityInterval > 0;
+			i++;
+		}
+		else if (arg == "--callgraph" && value)
+		{
+			opts.callGraphFile = value;
+			i++;
+		}
+		else if (arg == "--host-profile")
+		{
+			opts.hostProfile = true;
+		}
+		else if (arg == "--progress" && value)
+		{
+			char *end = nullptr;
+			opts.progressSeconds = strtod(value, &end);
+			ok = *end == '\0' && opts.progressSeconds > 0;
+			i++;
+		}
+		else if (arg == "--max-cycles" && value)
+		{
+			ok = ParseNumber(value, opts.maxCycles) && opts.maxCycles > 0;
+			i++;
+		}
+		else if (arg == "--timeout" && value)
+		{
+			char *end = nullptr;
+			opts.timeoutSeconds = strtod(value, &end);
+			ok = *end == '\0' && opts.timeoutSeconds > 0;
+			i++;
+		}
+		else if (arg == "--trace" && value)
+		{
+			opts.traceFile = value;
+			i++;
+		}
+		else if (arg == "--trace-compress" && value)
+		{
+			std::string mode = value;
+			ok = mode == "zlib" || mode == "none";
+			opts.traceCompress = mode == "zlib";
+			i++;
+		}
+		else if (arg == "--trace-print" && value)
+		{
+			opts.tracePrintFile = value;
+			i++;
+		}
+		else if (arg == "--capture-accesses" && value)
+		{
+			opts.captureFile = value;
+			i++;
+		}
+		else if (arg == "--replay" && value)
+		{
+			opts.replayFile = value;
+			i++;
+		}
+		else if (arg == "--memory" && value)
+		{
+			std::string model = value;
+			ok = model == "cached" || model == "uncached";
+			opts.uncached = model == "uncached";
+			i++;
+		}
+		else if (arg == "--guest-memory" && value)
+		{
+			// Programs, --generate included, put their stack at the top of the default size
+			uint64_t bytes = 0;
+			ok = ParseNumber(value, bytes) && bytes >= memBytes && bytes <= maxMemBytes
+			     && bytes % checkpointPageBytes == 0;
+			opts.guestMemoryBytes = bytes;
+			i++;
+		}
+		else if (arg == "--replay-memory" && value)
+		{
+			std::string model = value;
+			ok = model == "cached" || model == "uncached";
+			opts.replayUncached = model == "uncached";
+			i++;
+		}
+		else if (arg == "--replay-cache" && value)
+		{
+			ok = ParseCacheConfig(value, opts.replayCache);
+			i++;
+		}
+		else if (arg == "--fast-forward" && value)
+		{
+			ok = ParseMarker(value, opts.fastForwardTo);
+			i++;
+		}
+		else if (arg == "--warm-from" && value)
+		{
+			ok = ParseMarker(value, opts.warmFrom);
+			i++;
+		}
+		else if (arg == "--checkpoint" && value)
+		{
+			opts.checkpointFile = value;
+			i++;
+		}
+		else if (arg == "--checkpoint-at" && value)
+		{
+			ok = ParseMarker(value, opts.checkpointAt);
+			i++;
+		}
+		else if (arg == "--restore" && value)
+		{
+			opts.restoreFile = value;
+			i++;
+		}
+		else if (arg == "--preload" && value)
+		{
+			MemoryFile preload;
+			ok = ParsePreload(value, preload);
+			opts.preloads.push_back(preload);
+			i++;
+		}
+		else if (arg == "--dump-memory" && value)
+		{
+			MemoryFile dump;
+			ok = ParseMemoryDump(value, dump);
+			opts.memoryDumps.push_back(dump);
+			i++;
+		}
+		else if (arg == "--sweep-at" && value)
+		{
+			ok = ParseMarker(value, opts.sweepAt);
+			i++;
+		}
+		else if (arg == "--sweep" && value)
+		{
+			CacheConfig config;
+			ok = ParseCacheConfig(value, config);
+			opts.sweepConfigs.push_back(config);
+			i++;
+		}
+		else if (arg == "--sample")
+		{
+			opts.sample = true;
+		}
+		else if (arg == "--sample-period" && value)
+		{
+			ok = ParseNumber(value, opts.sampleConfig.period);
+			i++;
+		}
+		else if (arg == "--sample-warmup" && value)
+		{
+			ok = ParseNumber(value, opts.sampleConfig.warmup);
+			i++;
+		}
+		else if (arg == "--sample-window" && value)
+		{
+			ok = ParseNumber(value, opts.sampleConfig.window) && opts.sampleConfig.window > 0;
+			i++;
+		}
+		else if (arg == "--sample-error" && value)
+		{
+			char *end = nullptr;
+			opts.sampleConfig.targetError = strtod(value, &end);
+			ok = *end == '\0' && opts.sampleConfig.targetError > 0;
+			i++;
+		}
+		else if (arg[0] != '-')
+		{
+			opts.program = arg;
+		}
+		else
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			fprintf(stderr, "ERROR: bad argument \"%s\"\n", arg.c_str());
+			PrintUsage(argv[0]);
+			return false;
+		}
+	}
+
+	// The trace writer thread would not survive the fork of the sweep children
+	if (!opts.traceFile.empty() && !opts.sweepConfigs.empty())
+	{
+		fprintf(stderr, "ERROR: --trace cannot be combined with --sweep\n");
+		return false;
+	}
+
+	if (!opts.generateOut.empty() && opts.generateSpec.empty())
+	{
+		fprintf(stderr, "ERROR: --generate-out needs --generate\n");
+		return false;
+	}
+
+	// A checkpoint already holds the memory image, including cached lines
+	if (!opts.preloads.empty() && !opts.restoreFile.empty())
+	{
+		fprintf(stderr, "ERROR: --preload cannot be combined with --restore\n");
+		return false;
+	}
+	if (opts.guestMemoryBytes != memBytes && !opts.restoreFile.empty())
+	{
+		fprintf(stderr, "ERROR: --guest-memory cannot be combined with --restore\n");
+		return false;
+	}
+
+	// Every sweep child ends with its own memory image, the parent with none
+	if (!opts.memoryDumps.empty() && !opts.sweepConfigs.empty())
+	{
+		fprintf(stderr, "ERROR: --dump-memory cannot be combined with --sweep\n");
+		return false;
+	}
+
+	// Checkpoints, sweeps and the cache observers work on the state of the caches
+	if (opts.uncached
+	    && (!opts.checkpointFile.empty() || !opts.restoreFile.empty() || !opts.sweepConfigs.empty()
+	        || opts.missClasses || opts.stackDistance || opts.locality || !opts.captureFile.empty()))
+	{
+		fprintf(stderr, "ERROR: --memory uncached cannot be combined with checkpoints, sweeps, "
+		                "--miss-classes, --stack-distance, --locality or --capture-accesses\n");
+		return false;
+	}
+
+	const SampleConfig &sc = opts.sampleConfig;
+	if (uint64_t(sc.warmup) + sc.window >= sc.period)
+	{
+		fprintf(stderr, "ERROR: the sample period must be longer than warmup and window together\n");
+		return false;
+	}
+	return true;
+}
+
+#endif //RISCV_SIM_OPTIONS_H
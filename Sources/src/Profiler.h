@@ -0,0 +1,127 @@
+#ifndef RISCV_SIM_PROFILER_H
+#define RISCV_SIM_PROFILER_H
+
+#include "SymbolTable.h"
+#include "Memory/MemoryConfig.h"
+#include "Memory/MemoryStorage.h"
+
+#include <cstdio>
+#include <map>
+#include <vector>
+
+// Per-PC cycle attribution. Every retired instruction is charged with the cycles and
+// cache misses since the previous retirement, in a flat array indexed by
+// (pc - textBegin) / 4; PCs outside the text range share one extra entry
+class Profiler
+{
+public:
+	Profiler(Word textBegin, Word textEnd)
+			: _base(textBegin), _entries((textEnd - textBegin) / sizeof(Word))
+	{
+	}
+
+	void Start(uint64_t cycle, const CacheStats &cache)
+	{
+		_lastCycle = cycle;
+		_lastCodeMisses = cache.codeMisses;
+		_lastDataMisses = cache.dataMisses;
+	}
+
+	void Retire(Word pc, uint64_t cycle, const CacheStats &cache)
+	{
+		size_t index = (pc - _base) / sizeof(Word);
+		Entry &entry = index < _entries.size() ? _entries[index] : _other;
+		entry.count++;
+		entry.cycles += cycle - _lastCycle;
+		entry.codeMisses += cache.codeMisses - _lastCodeMisses;
+		entry.dataMisses += cache.dataMisses - _lastDataMisses;
+		_lastCycle = cycle;
+		_lastCodeMisses = cache.codeMisses;
+		_lastDataMisses = cache.dataMisses;
+	}
+
+	void Report(FILE *out, const SymbolTable &symbols, const MemoryStorage &mem, size_t topN) const
+	{
+		uint64_t totalCycles = _other.cycles;
+		std::map<std::string, Entry> functions;
+		std::vector<std::pair<Word, const Entry *>> instructions;
+		for (size_t i = 0; i < _entries.size(); i++)
+		{
+			const Entry &entry = _entries[i];
+			if (entry.count == 0)
+				continue;
+
+			Word pc = _base + Word(i * sizeof(Word));
+			const SymbolTable::Symbol *sym = symbols.Lookup(pc);
+			functions[sym ? sym->name : "??"].Add(entry);
+			instructions.emplace_back(pc, &entry);
+			totalCycles += entry.cycles;
+		}
+		if (_other.count != 0)
+			functions["(outside text)"].Add(_other);
+
+		std::vector<std::pair<std::string, Entry>> byFunction(functions.begin(), functions.end());
+		auto topFunctions = std::min(topN, byFunction.size());
+		std::partial_sort(byFunction.begin(), byFunction.begin() + topFunctions, byFunction.end(),
+		                  [](auto &a, auto &b) { return a.second.cycles > b.second.cycles; });
+
+		fprintf(out, "Top %zu functions by cycles:\n", topFunctions);
+		fprintf(out, "%12s %6s %12s %8s %8s  %s\n", "cycles", "%", "instret", "i-miss", "d-miss", "function");
+		for (size_t i = 0; i < topFunctions; i++)
+		{
+			const Entry &e = byFunction[i].second;
+			fprintf(out, "%12lu %6.2f %12lu %8lu %8lu  %s\n",
+			        (unsigned long) e.cycles, Percent(e.cycles, totalCycles), (unsigned long) e.count,
+			        (unsigned long) e.codeMisses, (unsigned long) e.dataMisses, byFunction[i].first.c_str());
+		}
+
+		auto topInstructions = std::min(topN, instructions.size());
+		std::partial_sort(instructions.begin(), instructions.begin() + topInstructions, instructions.end(),
+		                  [](auto &a, auto &b) { return a.second->cycles > b.second->cycles; });
+
+		fprintf(out, "\nTop %zu instructions by cycles:\n", topInstructions);
+		fprintf(out, "%12s %6s %12s %8s %8s  %-10s %-8s  %s\n",
+		        "cycles", "%", "count", "i-miss", "d-miss", "pc", "insn", "location");
+		for (size_t i = 0; i < topInstructions; i++)
+		{
+			Word pc = instructions[i].first;
+			const Entry &e = *instructions[i].second;
+			fprintf(out, "%12lu %6.2f %12lu %8lu %8lu  0x%08x %08x  %s\n",
+			        (unsigned long) e.cycles, Percent(e.cycles, totalCycles), (unsigned long) e.count,
+			        (unsigned long) e.codeMisses, (unsigned long) e.dataMisses, pc, mem.Read(pc),
+			        symbols.Describe(pc).c_str());
+		}
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t count = 0;
+		uint64_t cycles = 0;
+		uint64_t codeMisses = 0;
+		uint64_t dataMisses = 0;
+
+		void Add(const Entry &other)
+		{
+			count += other.count;
+			cycles += other.cycles;
+			codeMisses += other.codeMisses;
+			dataMisses += other.dataMisses;
+		}
+	};
+
+	static double Percent(uint64_t part, uint64_t total)
+	{
+		return total ? 100.0 * part / total : 0.0;
+	}
+
+	Word _base;
+	std::vector<Entry> _entries;
+	Entry _other;
+
+	uint64_t _lastCycle = 0;
+	uint64_t _lastCodeMisses = 0;
+	uint64_t _lastDataMisses = 0;
+};
+
+#endif //RISCV_SIM_PROFILER_H
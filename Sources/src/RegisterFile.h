@@ -3,6 +3,7 @@
 #define RISCV_SIM_REGISTERFILE_H
 
 #include "Instruction.h"
+#include "Checkpoint.h"
 
 class RegisterFile
 {
@@ -25,6 +26,22 @@ public:
         if (instr->_dst)
             _r.at(instr->_dst.value()) = instr->_data;
     }
+
+    // True if writing back `instr` would change a register
+    bool Changes(const InstructionPtr& instr) const
+    {
+        return instr->_dst && _r.at(instr->_dst.value()) != instr->_data;
+    }
+
+    void Save(CheckpointWriter &cp) const
+    {
+        cp.Put(_r);
+    }
+
+    void Restore(CheckpointReader &cp)
+    {
+        cp.Get(_r);
+    }
 private:
     std::array<Word, 32> _r;
 };
@@ -0,0 +1,133 @@
+#ifndef RISCV_SIM_SAMPLING_H
+#define RISCV_SIM_SAMPLING_H
+
+#include "Cpu.h"
+#include "Host.h"
+#include "Memory/CachedMemory.h"
+
+#include <cmath>
+#include <vector>
+
+// SMARTS-style systematic sampling: every `period` instructions the run switches from
+// functional warming (Cpu::Step with caches updated) to the detailed timing model for
+// `warmup` instructions, whose timing is discarded, followed by a measured `window`
+struct SampleConfig
+{
+	Word period = 10000;
+	Word warmup = 2000;
+	Word window = 1000;
+	// Target half-width of the confidence interval, relative to the mean CPI
+	double targetError = 0.03;
+};
+
+struct SampleReport
+{
+	// z for a two-sided 95% confidence interval
+	static constexpr double z = 1.96;
+
+	std::vector<double> cpi;
+	uint64_t instret = 0;
+
+	double Mean() const
+	{
+		double sum = 0;
+		for (double c : cpi)
+			sum += c;
+		return cpi.empty() ? 0 : sum / cpi.size();
+	}
+
+	double StdDev() const
+	{
+		if (cpi.size() < 2)
+			return 0;
+		double mean = Mean();
+		double sum = 0;
+		for (double c : cpi)
+			sum += (c - mean) * (c - mean);
+		return std::sqrt(sum / (cpi.size() - 1));
+	}
+
+	double HalfWidth() const
+	{
+		return cpi.empty() ? 0 : z * StdDev() / std::sqrt(double(cpi.size()));
+	}
+
+	// Number of samples needed for the interval to shrink to `targetError` of the mean
+	size_t RequiredSamples(double targetError) const
+	{
+		double mean = Mean();
+		if (mean == 0)
+			return 0;
+		double n = z * StdDev() / mean / targetError;
+		return size_t(std::ceil(n * n));
+	}
+};
+
+template<typename Memory>
+class Sampler
+{
+public:
+	Sampler(BasicCpu<Memory> &cpu, Memory &cache, const SampleConfig &config)
+			: _cpu(cpu), _cache(cache), _config(config)
+	{
+	}
+
+	// Samples the guest from the current state until it exits
+	SampleReport Run(HostState &host)
+	{
+		SampleReport report;
+		Word warmInstructions = _config.period - _config.warmup - _config.window;
+
+		while (true)
+		{
+			uint64_t warmEnd = _cpu.GetInstret() + warmInstructions;
+			while (_cpu.GetInstret() < warmEnd)
+			{
+				_cpu.Step(true);
+				if (Poll(host))
+					break;
+			}
+			if (_exited || RunDetailed(_config.warmup, host))
+				break;
+
+			uint64_t startCycle = _cpu.GetCycle();
+			uint64_t startInstret = _cpu.GetInstret();
+			if (RunDetailed(_config.window, host))
+				break;
+			report.cpi.push_back(double(_cpu.GetCycle() - startCycle) / (_cpu.GetInstret() - startInstret));
+		}
+
+		report.instret = _cpu.GetInstret();
+		return report;
+	}
+
+private:
+	// Runs the timing model until `count` more instructions retired; returns true if the
+	// guest exited on the way
+	bool RunDetailed(Word count, HostState &host)
+	{
+		uint64_t end = _cpu.GetInstret() + count;
+		while (_cpu.GetInstret() < end || !_cpu.AtInstructionBoundary())
+		{
+			_cpu.Clock();
+			_cache.Clock();
+			if (Poll(host))
+				return true;
+		}
+		return false;
+	}
+
+	bool Poll(HostState &host)
+	{
+		std::optional<CpuToHostData> msg = _cpu.GetMessage();
+		_exited = msg && HandleMessage(*msg, host);
+		return _exited;
+	}
+
+	BasicCpu<Memory> &_cpu;
+	Memory &_cache;
+	SampleConfig _config;
+	bool _exited = false;
+};
+
+#endif //RISCV_SIM_SAMPLING_H
@@ -0,0 +1,146 @@
+#include "Simulator.h"
+
+#include <algorithm>
+
+Simulator::Simulator(const CacheConfig &config, size_t memoryBytes)
+		: _config(config), _memoryBytes(memoryBytes)
+{
+	Reset();
+}
+
+bool Simulator::LoadElf(const std::string &filename)
+{
+	Reset();
+	if (!_mem->LoadElf(filename))
+		return false;
+	_cpu->Reset(resetIp);
+	return true;
+}
+
+bool Simulator::LoadElf(const std::vector<char> &image)
+{
+	Reset();
+	if (!_mem->LoadElf(image))
+		return false;
+	_cpu->Reset(resetIp);
+	return true;
+}
+
+bool Simulator::LoadFile(const std::string &filename, Word addr)
+{
+	return _mem->LoadFile(filename, addr);
+}
+
+void Simulator::Reset()
+{
+	// Dirty lines, registers and pipeline state of a previous run would otherwise leak
+	// into the next program; the CPU goes first as it refers to the cache
+	_cpu.reset();
+	_cache.reset();
+	_mem.reset(new MemoryStorage(_memoryBytes));
+	_cache.reset(new CachedMemory(*_mem, _config));
+	_cpu.reset(new Cpu(*_cache));
+
+	_host.print_int = 0;
+	_host.exitCode = 0;
+	FlushGuestOutput(_host);
+	_host.arrayTags.clear();
+	_host.io = &_mem->GetHostIo();
+	_finished.reset();
+}
+
+Simulator::StopReason Simulator::Run(uint64_t maxCycles)
+{
+	return RunUntil(Marker(), maxCycles);
+}
+
+Simulator::StopReason Simulator::RunUntil(const Marker &marker, uint64_t maxCycles)
+{
+	// The harness may look at the guest output as soon as it has control again
+	StopReason reason = Dispatch(marker, maxCycles);
+	FlushGuestOutput(_host);
+	return reason;
+}
+
+Simulator::StopReason Simulator::Dispatch(const Marker &marker, uint64_t maxCycles)
+{
+	if (_finished)
+		return *_finished;
+	if (marker.IsSet() && _cpu->AtInstructionBoundary() && marker.Reached(*_cpu))
+		return StopReason::Marker;
+
+	// One loop per kind of marker, with its target in a local. _ip and instret only
+	// change as an instruction retires, so the boundary test after the compare is
+	// only reached on the cycle that matched
+	Word pc = Word(marker.value);
+	uint64_t instret = marker.value;
+	Cpu &cpu = *_cpu;
+	switch (marker.kind)
+	{
+		case Marker::Kind::Pc:
+			return Loop(maxCycles, marker, [&cpu, pc] {
+				return cpu.GetIp() == pc && cpu.AtInstructionBoundary();
+			});
+		case Marker::Kind::Instret:
+			return Loop(maxCycles, marker, [&cpu, instret] {
+				return cpu.GetInstret() >= instret && cpu.AtInstructionBoundary();
+			});
+		case Marker::Kind::CycleRead:
+			return Loop(maxCycles, marker, [&cpu] {
+				return cpu.AtInstructionBoundary() && cpu.NextReadsCycle();
+			});
+		default:
+			// Markers sent through mtohost are matched in Serve
+			return Loop(maxCycles, marker, [] { return false; });
+	}
+}
+
+template<typename Stop>
+Simulator::StopReason Simulator::Loop(uint64_t maxCycles, const Marker &marker, Stop stop)
+{
+	Cpu &cpu = *_cpu;
+	CachedMemory &cache = *_cache;
+	uint64_t end = cpu.GetCycle() + std::min(maxCycles, noCycleLimit - cpu.GetCycle());
+	while (cpu.GetCycle() < end)
+	{
+		cpu.Clock();
+		cache.Clock();
+		// Only a raised flag costs a call into the CSR file and the host I/O device
+		if (cpu.MessagePending())
+		{
+			std::optional<CpuToHostData> msg = cpu.GetMessage();
+			if (msg)
+			{
+				if (std::optional<StopReason> reason = Serve(*msg, marker))
+					return *reason;
+			}
+		}
+		if (stop())
+			return StopReason::Marker;
+	}
+	return StopReason::MaxCycles;
+}
+
+// Returns why the run stops, if this message stops it
+std::optional<Simulator::StopReason> Simulator::Serve(CpuToHostData msg, const Marker &marker)
+{
+	bool stop = _callback && _callback(msg);
+	if (marker.Matches(msg))
+	{
+		// Let the marker write retire so the state is at an instruction boundary
+		while (!_cpu->AtInstructionBoundary())
+		{
+			_cpu->Clock();
+			_cache->Clock();
+		}
+		return StopReason::Marker;
+	}
+	if (HandleMessage(msg, _host))
+	{
+		_finished = msg.unpacked.type == CpuToHostType::Halt ? StopReason::Halted : StopReason::Exited;
+		return _finished;
+	}
+	if (stop)
+		return StopReason::Callback;
+	return std::nullopt;
+}
@@ -0,0 +1,157 @@
+#ifndef RISCV_SIM_SIMULATOR_H
+#define RISCV_SIM_SIMULATOR_H
+
+#include "Cpu.h"
+#include "BaseTypes.h"
+#include "Host.h"
+#include "Marker.h"
+#include "Memory/CachedMemory.h"
+#include "Memory/MemoryConfig.h"
+#include "Memory/MemoryStorage.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// One guest on the cached timing model, for harnesses that drive many runs in-process
+// instead of spawning riscv_sim per test (the riscv_sim_lib target, libriscv_sim):
+//
+//   Simulator sim;
+//   sim.GetHost().quiet = true;
+//   if (!sim.LoadElf("qsort.riscv"))
+//       ...
+//   sim.RunUntil({Marker::Kind::Pc, 0x2a4});
+//   ...
+//   if (sim.Run() == Simulator::StopReason::Exited)
+//       printf("%d after %lu cycles\n", sim.GetHost().exitCode, sim.GetCycle());
+//
+// Messages are served as by riscv_sim (see HandleMessage), guest output going to
+// GetHost().output
+class Simulator
+{
+public:
+	enum class StopReason
+	{
+		// The guest sent its exit code, which is in GetHost().exitCode
+		Exited,
+		// The simulator ended the run (see HaltReason), GetHost().exitCode tells which way
+		Halted,
+		// The marker of RunUntil was reached
+		Marker,
+		// The message callback asked to stop
+		Callback,
+		// maxCycles ran out first
+		MaxCycles
+	};
+
+	// Called with every message before it is served; returning true stops the run once
+	// the message has been served
+	using MessageCallback = std::function<bool(CpuToHostData msg)>;
+
+	static constexpr uint64_t noCycleLimit = UINT64_MAX;
+	static constexpr Word resetIp = 0x200;
+
+	// `memoryBytes` as for riscv_sim --guest-memory
+	explicit Simulator(const CacheConfig &config = CacheConfig(), size_t memoryBytes = memBytes);
+
+	Simulator(const Simulator &) = delete;
+
+	Simulator &operator=(const Simulator &) = delete;
+
+	// Starts over with fresh guest memory, caches, CPU and host state, loads a program
+	// and resets the CPU to it; false on error. Settings of GetHost() (quiet, output,
+	// arrayPrefix) are kept, while references from GetCpu(), GetCache() and GetMemory()
+	// and anything attached to the old CPU are not carried over
+	bool LoadElf(const std::string &filename);
+
+	bool LoadElf(const std::vector<char> &image);
+
+	// Loads a raw host file into guest memory, e.g. an input dataset after LoadElf
+	bool LoadFile(const std::string &filename, Word addr);
+
+	// Runs for at most maxCycles more cycles or until the guest exits; once it has, every
+	// further run returns the same reason at once
+	StopReason Run(uint64_t maxCycles = noCycleLimit);
+
+	// Also stops, at an instruction boundary, on reaching `marker`; a marker that already
+	// holds when called returns at once
+	StopReason RunUntil(const Marker &marker, uint64_t maxCycles = noCycleLimit);
+
+	void SetMessageCallback(MessageCallback callback)
+	{
+		_callback = std::move(callback);
+	}
+
+	// Memory as the guest sees it, dirty cache lines included
+	Word ReadWord(Word addr) const
+	{
+		return _cache->PeekData(addr);
+	}
+
+	uint64_t GetCycle() const
+	{
+		return _cpu->GetCycle();
+	}
+
+	uint64_t GetInstret() const
+	{
+		return _cpu->GetInstret();
+	}
+
+	Word GetIp() const
+	{
+		return _cpu->GetIp();
+	}
+
+	// True once the guest exited or was halted
+	bool Finished() const
+	{
+		return _finished.has_value();
+	}
+
+	HostState &GetHost()
+	{
+		return _host;
+	}
+
+	// The components themselves, for statistics, profilers and checkpoints
+	Cpu &GetCpu()
+	{
+		return *_cpu;
+	}
+
+	CachedMemory &GetCache()
+	{
+		return *_cache;
+	}
+
+	MemoryStorage &GetMemory()
+	{
+		return *_mem;
+	}
+
+private:
+	// Replaces every component of the last run
+	void Reset();
+
+	StopReason Dispatch(const Marker &marker, uint64_t maxCycles);
+
+	template<typename Stop>
+	StopReason Loop(uint64_t maxCycles, const Marker &marker, Stop stop);
+
+	std::optional<StopReason> Serve(CpuToHostData msg, const Marker &marker);
+
+	CacheConfig _config;
+	size_t _memoryBytes;
+	std::unique_ptr<MemoryStorage> _mem;
+	std::unique_ptr<CachedMemory> _cache;
+	std::unique_ptr<Cpu> _cpu;
+	HostState _host;
+	MessageCallback _callback;
+	std::optional<StopReason> _finished;
+};
+
+#endif //RISCV_SIM_SIMULATOR_H
@@ -0,0 +1,164 @@
+#ifndef RISCV_SIM_STATS_H
+#define RISCV_SIM_STATS_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Central list of named statistics. Components keep their counters as plain integer
+// members and only register references to them, so updating a counter on the hot path
+// is an ordinary increment; names are resolved only when the registry is dumped
+class StatsRegistry
+{
+public:
+	enum class Format
+	{
+		Json,
+		Csv
+	};
+
+	template<typename T>
+	void AddCounter(const std::string &name, const T &counter)
+	{
+		_entries.push_back({name, [&counter] { return double(counter); }, nullptr, {}, true});
+	}
+
+	// `buckets` must hold one counter per label
+	void AddHistogram(const std::string &name, const uint64_t *buckets, std::vector<std::string> labels)
+	{
+		_entries.push_back({name, nullptr, buckets, std::move(labels), true});
+	}
+
+	void AddFormula(const std::string &name, std::function<double()> formula)
+	{
+		_entries.push_back({name, std::move(formula), nullptr, {}, false});
+	}
+
+	// Value of a counter or formula, NaN if there is none with this name
+	double Value(const std::string &name) const
+	{
+		for (const Entry &entry : _entries)
+		{
+			if (entry.name == name && entry.value)
+				return entry.value();
+		}
+		return NAN;
+	}
+
+	// Ratio that is NaN rather than infinite for an empty denominator
+	static double Ratio(double num, double den)
+	{
+		return den != 0 ? num / den : NAN;
+	}
+
+	// Writes every statistic to `filename` ("-" for stdout)
+	bool Dump(const std::string &filename, Format format) const
+	{
+		FILE *out = filename == "-" ? stdout : fopen(filename.c_str(), "w");
+		if (out == nullptr)
+		{
+			fprintf(stderr, "ERROR: failed opening stats file \"%s\"\n", filename.c_str());
+			return false;
+		}
+
+		if (format == Format::Json)
+			DumpJson(out);
+		else
+			DumpCsv(out);
+
+		bool ok = !ferror(out);
+		if (out != stdout)
+			ok = fclose(out) == 0 && ok;
+		else
+			fflush(out);
+		return ok;
+	}
+
+	// Labels "0", "1", "2-3", "4-7", ... for a histogram indexed by Log2Bucket
+	static std::vector<std::string> Log2Labels(size_t buckets)
+	{
+		std::vector<std::string> labels {"0"};
+		for (size_t i = 1; i < buckets; i++)
+		{
+			uint64_t low = uint64_t(1) << (i - 1);
+			uint64_t high = (uint64_t(1) << i) - 1;
+			labels.push_back(i + 1 == buckets ? std::to_string(low) + "+"
+			                                  : low == high ? std::to_string(low)
+			                                                : std::to_string(low) + "-" + std::to_string(high));
+		}
+		return labels;
+	}
+
+	// Bucket of `value` in a histogram of `buckets` power-of-two sized buckets
+	static size_t Log2Bucket(uint64_t value, size_t buckets)
+	{
+		size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+		return bucket < buckets ? bucket : buckets - 1;
+	}
+
+private:
+	struct Entry
+	{
+		std::string name;
+		std::function<double()> value;
+		const uint64_t *buckets;
+		std::vector<std::string> labels;
+		bool integral;
+	};
+
+	static void PrintNumber(FILE *out, double value, bool integral, const char *nan)
+	{
+		if (std::isnan(value) || std::isinf(value))
+			fprintf(out, "%s", nan);
+		else if (integral)
+			fprintf(out, "%.0f", value);
+		else
+			fprintf(out, "%.6g", value);
+	}
+
+	void DumpJson(FILE *out) const
+	{
+		fprintf(out, "{");
+		for (size_t i = 0; i < _entries.size(); i++)
+		{
+			const Entry &entry = _entries[i];
+			fprintf(out, "%s\n  \"%s\": ", i ? "," : "", entry.name.c_str());
+			if (entry.buckets == nullptr)
+			{
+				PrintNumber(out, entry.value(), entry.integral, "null");
+				continue;
+			}
+
+			fprintf(out, "{");
+			for (size_t b = 0; b < entry.labels.size(); b++)
+				fprintf(out, "%s\"%s\": %lu", b ? ", " : "", entry.labels[b].c_str(), (unsigned long) entry.buckets[b]);
+			fprintf(out, "}");
+		}
+		fprintf(out, "\n}\n");
+	}
+
+	void DumpCsv(FILE *out) const
+	{
+		fprintf(out, "name,value\n");
+		for (const Entry &entry : _entries)
+		{
+			if (entry.buckets == nullptr)
+			{
+				fprintf(out, "%s,", entry.name.c_str());
+				PrintNumber(out, entry.value(), entry.integral, "");
+				fprintf(out, "\n");
+				continue;
+			}
+
+			for (size_t b = 0; b < entry.labels.size(); b++)
+				fprintf(out, "%s.%s,%lu\n", entry.name.c_str(), entry.labels[b].c_str(), (unsigned long) entry.buckets[b]);
+		}
+	}
+
+	std::vector<Entry> _entries;
+};
+
+#endif //RISCV_SIM_STATS_H
@@ -0,0 +1,90 @@
+#ifndef RISCV_SIM_SYMBOLTABLE_H
+#define RISCV_SIM_SYMBOLTABLE_H
+
+#include "BaseTypes.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Code symbols of the loaded program, for turning guest PCs back into function names
+class SymbolTable
+{
+public:
+	struct Symbol
+	{
+		std::string name;
+		Word addr;
+		// 0 for assembly labels, which extend up to the next symbol
+		Word size;
+	};
+
+	void Add(const std::string &name, Word addr, Word size)
+	{
+		_symbols.push_back({name, addr, size});
+		_sorted = false;
+	}
+
+	void Clear()
+	{
+		_symbols.clear();
+	}
+
+	bool Empty() const
+	{
+		return _symbols.empty();
+	}
+
+	// Symbol containing `pc`, nullptr if there is none
+	const Symbol *Lookup(Word pc) const
+	{
+		Sort();
+		auto next = std::upper_bound(_symbols.begin(), _symbols.end(), pc,
+		                             [](Word pc, const Symbol &sym) { return pc < sym.addr; });
+		if (next == _symbols.begin())
+			return nullptr;
+
+		const Symbol &sym = *(next - 1);
+		if (sym.size != 0 && pc - sym.addr >= sym.size)
+			return nullptr;
+		return &sym;
+	}
+
+	// "name+0x10", or the bare address if no symbol contains `pc`
+	std::string Describe(Word pc) const
+	{
+		char buf[32];
+		const Symbol *sym = Lookup(pc);
+		if (sym == nullptr)
+		{
+			snprintf(buf, sizeof(buf), "0x%08x", pc);
+			return buf;
+		}
+		if (pc == sym->addr)
+			return sym->name;
+		snprintf(buf, sizeof(buf), "+0x%x", pc - sym->addr);
+		return sym->name + buf;
+	}
+
+private:
+	// Sized (function) symbols sort before labels at the same address, so that
+	// the label is dropped
+	void Sort() const
+	{
+		if (_sorted)
+			return;
+		std::sort(_symbols.begin(), _symbols.end(), [](const Symbol &a, const Symbol &b) {
+			return a.addr != b.addr ? a.addr < b.addr : a.size > b.size;
+		});
+		_symbols.erase(std::unique(_symbols.begin(), _symbols.end(),
+		                           [](const Symbol &a, const Symbol &b) { return a.addr == b.addr; }),
+		               _symbols.end());
+		_sorted = true;
+	}
+
+	mutable std::vector<Symbol> _symbols;
+	mutable bool _sorted = true;
+};
+
+#endif //RISCV_SIM_SYMBOLTABLE_H
@@ -0,0 +1,395 @@
+#ifndef RISCV_SIM_TRACE_H
+#define RISCV_SIM_TRACE_H
+
+#include "Instruction.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+// Execution traces are a file header followed by independent blocks of records, one
+// record per retired instruction: PC, instruction word, destination register value and
+// the address and data of a load or store. Each record is a flags byte followed only by
+// what cannot be predicted from the previous records of its block: the PC if it is not
+// the fall-through one after the previous record, the instruction word if it differs from the last one seen at
+// that PC, and zigzag varint deltas of the destination value (against the old register
+// value), the address and the data. Blocks are optionally zlib-compressed
+static constexpr uint32_t traceMagic = 0x52545652; // "RVTR"
+static constexpr uint32_t traceVersion = 1;
+
+struct TraceRecord
+{
+	Word pc = 0;
+	Word insn = 0;
+	bool hasDst = false;
+	RId rd = 0;
+	Word dstValue = 0;
+	bool load = false;
+	bool store = false;
+	Word addr = 0;
+	Word data = 0;
+};
+
+// What the writer and the reader both know at a point of a block
+class TraceContext
+{
+public:
+	enum Flags : uint8_t
+	{
+		Jump = 1u << 0u,
+		NewInsn = 1u << 1u,
+		Dst = 1u << 2u,
+		Load = 1u << 3u,
+		Store = 1u << 4u,
+		// Load data is the destination value unless the load writes x0
+		Data = 1u << 5u,
+	};
+
+	void Reset()
+	{
+		nextPc = 0;
+		regs.fill(0);
+		insns.fill(0);
+		lastAddr = 0;
+		lastData = 0;
+	}
+
+	Word &Insn(Word pc)
+	{
+		return insns[(pc >> 2u) % insns.size()];
+	}
+
+	static RId Rd(Word insn)
+	{
+		return RId((insn >> 7u) & 0x1fu);
+	}
+
+	Word nextPc = 0;
+	std::array<Word, 32> regs {};
+	std::array<Word, 1024> insns {};
+	Word lastAddr = 0;
+	Word lastData = 0;
+};
+
+// Records are encoded on the simulation thread into one block while a background thread
+// compresses and writes out the previous one
+class TraceWriter
+{
+public:
+	~TraceWriter()
+	{
+		Close();
+	}
+
+	bool Open(const std::string &filename, bool compress)
+	{
+		_file = fopen(filename.c_str(), "wb");
+		if (_file == nullptr)
+		{
+			fprintf(stderr, "ERROR: failed opening trace file \"%s\"\n", filename.c_str());
+			return false;
+		}
+
+		uint32_t header[] = {traceMagic, traceVersion, compress};
+		_ok = fwrite(header, sizeof(header), 1, _file) == 1;
+		_compress = compress;
+		_fill.resize(blockBytes + maxRecordBytes);
+		_pending.resize(blockBytes + maxRecordBytes);
+		_context.Reset();
+		_writer = std::thread(&TraceWriter::WriterLoop, this);
+		return _ok;
+	}
+
+	void Retire(Word pc, Word insn, const Instruction &instr)
+	{
+		uint8_t *start = _fill.data() + _used;
+		uint8_t *p = start + 1;
+		uint8_t flags = 0;
+
+		if (pc != _context.nextPc)
+		{
+			flags |= TraceContext::Jump;
+			p = PutDelta(p, pc, _context.nextPc);
+		}
+		_context.nextPc = pc + 4;
+
+		Word &cachedInsn = _context.Insn(pc);
+		if (insn != cachedInsn)
+		{
+			flags |= TraceContext::NewInsn;
+			memcpy(p, &insn, sizeof(insn));
+			p += sizeof(insn);
+			cachedInsn = insn;
+		}
+
+		if (instr._dst)
+		{
+			flags |= TraceContext::Dst;
+			Word &reg = _context.regs[*instr._dst];
+			p = PutDelta(p, instr._data, reg);
+			reg = instr._data;
+		}
+
+		if (instr._type == IType::Ld || instr._type == IType::St)
+		{
+			flags |= instr._type == IType::Ld ? TraceContext::Load : TraceContext::Store;
+			p = PutDelta(p, instr._addr, _context.lastAddr);
+			_context.lastAddr = instr._addr;
+			if (instr._type == IType::St || !instr._dst)
+			{
+				flags |= TraceContext::Data;
+				p = PutDelta(p, instr._data, _context.lastData);
+			}
+			_context.lastData = instr._data;
+		}
+
+		*start = flags;
+		_used = p - _fill.data();
+		if (_used >= blockBytes)
+			EndBlock();
+	}
+
+	bool Close()
+	{
+		if (_file == nullptr)
+			return _ok;
+
+		if (_used != 0)
+			EndBlock();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_done = true;
+		}
+		_wake.notify_all();
+		_writer.join();
+
+		if (fclose(_file) != 0)
+			_ok = false;
+		_file = nullptr;
+		if (!_ok)
+			fprintf(stderr, "ERROR: failed writing the trace file\n");
+		return _ok;
+	}
+
+private:
+	static constexpr size_t blockBytes = 1u << 20u;
+	// Flags, PC, instruction and three varints
+	static constexpr size_t maxRecordBytes = 1 + 5 + 4 + 3 * 5;
+
+	static uint8_t *PutDelta(uint8_t *p, Word value, Word base)
+	{
+		int32_t delta = int32_t(value - base);
+		uint32_t zigzag = (uint32_t(delta) << 1u) ^ uint32_t(delta >> 31);
+		while (zigzag >= 0x80)
+		{
+			*p++ = uint8_t(zigzag | 0x80u);
+			zigzag >>= 7u;
+		}
+		*p++ = uint8_t(zigzag);
+		return p;
+	}
+
+	// Hands the filled block to the writer thread, waiting for it to finish the
+	// previous one first, and starts a new block from a fresh context
+	void EndBlock()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wake.wait(lock, [this] { return !_hasPending; });
+		std::swap(_fill, _pending);
+		_pendingUsed = _used;
+		_hasPending = true;
+		lock.unlock();
+		_wake.notify_all();
+
+		_used = 0;
+		_context.Reset();
+	}
+
+	void WriterLoop()
+	{
+		std::vector<uint8_t> compressed(compressBound(blockBytes + maxRecordBytes));
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (true)
+		{
+			_wake.wait(lock, [this] { return _hasPending || _done; });
+			if (!_hasPending)
+				return;
+			lock.unlock();
+
+			const uint8_t *data = _pending.data();
+			uLongf stored = _pendingUsed;
+			if (_compress)
+			{
+				stored = compressed.size();
+				// Blocks that do not shrink are stored as they are
+				if (compress2(compressed.data(), &stored, data, _pendingUsed, 1) == Z_OK && stored < _pendingUsed)
+					data = compressed.data();
+				else
+					stored = _pendingUsed;
+			}
+
+			uint32_t header[] = {uint32_t(_pendingUsed), uint32_t(stored)};
+			if (fwrite(header, sizeof(header), 1, _file) != 1 || fwrite(data, stored, 1, _file) != 1)
+				_ok = false;
+
+			lock.lock();
+			_hasPending = false;
+			_wake.notify_all();
+		}
+	}
+
+	FILE *_file = nullptr;
+	bool _compress = false;
+	TraceContext _context;
+
+	std::vector<uint8_t> _fill;
+	size_t _used = 0;
+
+	std::thread _writer;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	// Guarded by _mutex
+	std::vector<uint8_t> _pending;
+	size_t _pendingUsed = 0;
+	bool _hasPending = false;
+	bool _done = false;
+	// Written by the writer thread, read after joining it
+	bool _ok = true;
+};
+
+class TraceReader
+{
+public:
+	~TraceReader()
+	{
+		if (_file != nullptr)
+			fclose(_file);
+	}
+
+	bool Open(const std::string &filename)
+	{
+		_file = fopen(filename.c_str(), "rb");
+		if (_file == nullptr)
+		{
+			fprintf(stderr, "ERROR: failed opening trace file \"%s\"\n", filename.c_str());
+			return false;
+		}
+
+		uint32_t header[3];
+		if (fread(header, sizeof(header), 1, _file) != 1 || header[0] != traceMagic || header[1] != traceVersion)
+		{
+			fprintf(stderr, "ERROR: \"%s\" is not a trace of this simulator version\n", filename.c_str());
+			return false;
+		}
+		_ok = true;
+		return true;
+	}
+
+	// False at the end of the trace or on a malformed block, see Ok()
+	bool Next(TraceRecord &record)
+	{
+		if (_pos == _block.size() && !ReadBlock())
+			return false;
+
+		uint8_t flags = _block[_pos++];
+		record.pc = flags & TraceContext::Jump ? GetDelta(_context.nextPc) : _context.nextPc;
+		_context.nextPc = record.pc + 4;
+
+		Word &cachedInsn = _context.Insn(record.pc);
+		if (flags & TraceContext::NewInsn)
+		{
+			if (_pos + sizeof(Word) > _block.size())
+				return Malformed();
+			memcpy(&cachedInsn, &_block[_pos], sizeof(Word));
+			_pos += sizeof(Word);
+		}
+		record.insn = cachedInsn;
+
+		record.hasDst = flags & TraceContext::Dst;
+		record.rd = record.hasDst ? TraceContext::Rd(record.insn) : 0;
+		if (record.hasDst)
+			record.dstValue = _context.regs[record.rd] = GetDelta(_context.regs[record.rd]);
+
+		record.load = flags & TraceContext::Load;
+		record.store = flags & TraceContext::Store;
+		if (record.load || record.store)
+		{
+			record.addr = _context.lastAddr = GetDelta(_context.lastAddr);
+			record.data = flags & TraceContext::Data ? GetDelta(_context.lastData) : record.dstValue;
+			_context.lastData = record.data;
+		}
+		return _ok || Malformed();
+	}
+
+	bool Ok() const
+	{
+		return _ok;
+	}
+
+private:
+	bool ReadBlock()
+	{
+		uint32_t header[2];
+		if (fread(header, sizeof(header), 1, _file) != 1)
+			return false;
+
+		_block.resize(header[0]);
+		_pos = 0;
+		_context.Reset();
+		if (header[1] == header[0])
+		{
+			if (fread(_block.data(), header[0], 1, _file) != 1)
+				return Malformed();
+			return !_block.empty();
+		}
+
+		std::vector<uint8_t> stored(header[1]);
+		uLongf size = header[0];
+		if (fread(stored.data(), stored.size(), 1, _file) != 1
+		    || uncompress(_block.data(), &size, stored.data(), stored.size()) != Z_OK || size != header[0])
+			return Malformed();
+		return !_block.empty();
+	}
+
+	Word GetDelta(Word base)
+	{
+		uint32_t zigzag = 0;
+		for (unsigned shift = 0; ; shift += 7)
+		{
+			if (_pos == _block.size() || shift > 28)
+			{
+				_ok = false;
+				return 0;
+			}
+			uint8_t byte = _block[_pos++];
+			zigzag |= uint32_t(byte & 0x7fu) << shift;
+			if (!(byte & 0x80u))
+				break;
+		}
+		int32_t delta = int32_t(zigzag >> 1u) ^ -int32_t(zigzag & 1u);
+		return base + Word(delta);
+	}
+
+	bool Malformed()
+	{
+		if (_ok)
+			fprintf(stderr, "ERROR: malformed trace block\n");
+		_ok = false;
+		_pos = _block.size();
+		return false;
+	}
+
+	FILE *_file = nullptr;
+	bool _ok = false;
+	TraceContext _context;
+	std::vector<uint8_t> _block;
+	size_t _pos = 0;
+};
+
+#endif //RISCV_SIM_TRACE_H
@@ -1,56 +1,606 @@
 #include "Cpu.h"
 #include "BaseTypes.h"
+#include "Options.h"
+#include "Checkpoint.h"
+#include "Marker.h"
+#include "Host.h"
+#include "Sampling.h"
+#include "Generator.h"
+#include "Profiler.h"
+#include "CallGraph.h"
+#include "Trace.h"
 #include "Memory/MemoryStorage.h"
 #include "Memory/CachedMemory.h"
+#include "Memory/AccessTrace.h"
+#include "Memory/LocalityProfiler.h"
+#include "Memory/MissClassifier.h"
+#include "Memory/StackDistance.h"
+#include "Memory/UncachedMemory.h"
 
 #include <optional>
+#include <type_traits>
+#include <vector>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
 
-int main()
+// Runs until the guest exits (returns true) or reaches `marker` (returns false)
+template<typename Memory>
+static bool RunUntil(BasicCpu<Memory> &cpu, Memory &cache, const Marker &marker, HostState &host)
 {
-	MemoryStorage mem;
-	mem.LoadElf("program");
-	std::unique_ptr<CachedMemory> memModelPtr(new CachedMemory(mem));
-	Cpu cpu {*memModelPtr};
-	cpu.Reset(0x200);
-
-	int32_t print_int = 0;
 	while (true)
 	{
+		if (marker.IsSet() && cpu.AtInstructionBoundary() && marker.Reached(cpu))
+			return false;
+
 		cpu.Clock();
-		memModelPtr->Clock();
+		cache.Clock();
 		std::optional<CpuToHostData> msg = cpu.GetMessage();
 		if (!msg)
 			continue;
 
-		auto type = msg.value().unpacked.type;
-		auto data = msg.value().unpacked.data;
-
-		if (type == CpuToHostType::ExitCode)
+		if (marker.Matches(*msg))
 		{
-			if (data == 0)
-			{
-				fprintf(stderr, "PASSED\n");
-				return 0;
-			}
-			else
+			// Let the marker write retire so the state is at an instruction boundary
+			while (!cpu.AtInstructionBoundary())
 			{
-				fprintf(stderr, "FAILED: exit code = %d\n", data);
-				return data;
+				cpu.Clock();
+				cache.Clock();
 			}
+			return false;
+		}
+		if (HandleMessage(*msg, host))
+			return true;
+	}
+}
+
+static bool SaveCheckpoint(const std::string &filename, const Cpu &cpu, const CachedMemory &cache,
+                           const MemoryStorage &mem)
+{
+	CheckpointWriter cp(filename);
+	cp.Put(checkpointMagic);
+	cp.Put(checkpointVersion);
+	cpu.Save(cp);
+	cache.Save(cp);
+	mem.Save(cp);
+	if (!cp.Close())
+	{
+		fprintf(stderr, "ERROR: failed writing checkpoint \"%s\"\n", filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool RestoreCheckpoint(const std::string &filename, Cpu &cpu, CachedMemory &cache, MemoryStorage &mem)
+{
+	CheckpointReader cp(filename);
+	if (cp.Get<uint32_t>() != checkpointMagic || cp.Get<uint32_t>() != checkpointVersion)
+	{
+		fprintf(stderr, "ERROR: \"%s\" is not a checkpoint of this simulator version\n", filename.c_str());
+		return false;
+	}
+	cpu.Restore(cp);
+	cache.Restore(cp);
+	if (!mem.Restore(cp) || !cp.Ok())
+	{
+		fprintf(stderr, "ERROR: failed reading checkpoint \"%s\"\n", filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Executes instructions back to back without timing until `marker`; returns true if the
+// guest exited first. The caches are bypassed (and so flushed up front) until `warmFrom`
+// is reached, from then on they are kept warm
+template<typename Memory>
+static bool FastForward(BasicCpu<Memory> &cpu, Memory &cache, const Marker &marker, const Marker &warmFrom,
+                        HostState &host)
+{
+	bool warm = false;
+	cache.Flush();
+
+	while (!marker.Reached(cpu))
+	{
+		if (!warm && warmFrom.IsSet() && warmFrom.Reached(cpu))
+			warm = true;
+
+		cpu.Step(warm);
+		std::optional<CpuToHostData> msg = cpu.GetMessage();
+		if (!msg)
+			continue;
+
+		if (marker.Matches(*msg))
+			return false;
+		if (warmFrom.Matches(*msg))
+			warm = true;
+		else if (HandleMessage(*msg, host))
+			return true;
+	}
+	return false;
+}
+
+// Loads the ELF named on the command line, or `generated` if a program was generated
+static bool LoadProgram(MemoryStorage &mem, const Options &opts, const std::vector<char> &generated)
+{
+	return opts.generateSpec.empty() ? mem.LoadElf(opts.program) : mem.LoadElf(generated);
+}
+
+static bool Preload(MemoryStorage &mem, const std::vector<MemoryFile> &preloads)
+{
+	for (const MemoryFile &preload : preloads)
+	{
+		if (!mem.LoadFile(preload.file, preload.addr))
+			return false;
+	}
+	return true;
+}
+
+// Dumps guest memory as the program sees it, dirty lines still in the cache included
+template<typename Memory>
+static bool DumpMemory(const Memory &cache, const MemoryStorage &mem, const std::vector<MemoryFile> &dumps)
+{
+	for (const MemoryFile &dump : dumps)
+	{
+		if (dump.addr > mem.GetBytes() || dump.bytes > mem.GetBytes() - dump.addr)
+		{
+			fprintf(stderr, "ERROR: memory dump \"%s\" is outside of the %zu bytes of guest memory\n",
+			        dump.file.c_str(), mem.GetBytes());
+			return false;
+		}
+
+		std::vector<Word> words(dump.bytes / sizeof(Word));
+		for (size_t i = 0; i < words.size(); i++)
+			words[i] = cache.PeekData(dump.addr + Word(i * sizeof(Word)));
+
+		FILE *file = fopen(dump.file.c_str(), "wb");
+		bool written = file != nullptr && fwrite(words.data(), sizeof(Word), words.size(), file) == words.size();
+		if (file != nullptr && fclose(file) != 0)
+			written = false;
+		if (!written)
+		{
+			fprintf(stderr, "ERROR: failed writing memory dump \"%s\"\n", dump.file.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+struct SweepResult
+{
+	CacheConfig config;
+	int32_t exitCode;
+	uint64_t cycles;
+	uint64_t instret;
+	CacheStats stats;
+};
+
+// Forks one child per configuration from the current (warmed-up) state, at most one
+// per host CPU at a time; every child gets a copy-on-write image of guest memory and of
+// the simulator, resizes the cache, runs the guest to completion and sends its
+// statistics back through a pipe
+static int RunSweep(Cpu &cpu, CachedMemory &cache, const std::vector<CacheConfig> &configs)
+{
+	struct Child
+	{
+		pid_t pid;
+		int fd;
+		size_t index;
+	};
+	std::vector<Child> running;
+	std::vector<std::optional<SweepResult>> results(configs.size());
+	size_t maxRunning = size_t(std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)));
+
+	auto collect = [&results](const Child &child) {
+		SweepResult result;
+		if (read(child.fd, &result, sizeof(result)) == sizeof(result))
+			results[child.index] = result;
+		close(child.fd);
+		waitpid(child.pid, nullptr, 0);
+	};
+	// On an error none of the children started so far is left behind
+	auto killAll = [&running] {
+		for (const Child &child : running)
+		{
+			kill(child.pid, SIGKILL);
+			close(child.fd);
+			waitpid(child.pid, nullptr, 0);
+		}
+		running.clear();
+	};
+
+	fflush(stdout);
+	fflush(stderr);
+	for (size_t i = 0; i < configs.size(); i++)
+	{
+		if (running.size() >= maxRunning)
+		{
+			collect(running.front());
+			running.erase(running.begin());
+		}
+
+		int fds[2];
+		if (pipe(fds) != 0)
+		{
+			perror("ERROR: sweep: pipe");
+			killAll();
+			return 1;
+		}
+
+		pid_t pid = fork();
+		if (pid < 0)
+		{
+			perror("ERROR: sweep: fork");
+			close(fds[0]);
+			close(fds[1]);
+			killAll();
+			return 1;
+		}
+		if (pid == 0)
+		{
+			close(fds[0]);
+			for (const Child &child : running)
+				close(child.fd);
+			HostState host;
+			host.quiet = true;
+			uint64_t startCycle = cpu.GetCycle();
+			uint64_t startInstret = cpu.GetInstret();
+			CacheStats startStats = cache.GetStats();
+
+			cache.Configure(configs[i]);
+			RunUntil(cpu, cache, Marker(), host);
+
+			SweepResult result {configs[i], host.exitCode, cpu.GetCycle() - startCycle,
+			                    cpu.GetInstret() - startInstret, CacheStats {}};
+			result.stats.codeAccesses = cache.GetStats().codeAccesses - startStats.codeAccesses;
+			result.stats.codeMisses = cache.GetStats().codeMisses - startStats.codeMisses;
+			result.stats.dataAccesses = cache.GetStats().dataAccesses - startStats.dataAccesses;
+			result.stats.dataMisses = cache.GetStats().dataMisses - startStats.dataMisses;
+			result.stats.writebacks = cache.GetStats().writebacks - startStats.writebacks;
+			bool sent = write(fds[1], &result, sizeof(result)) == sizeof(result);
+			_exit(sent ? 0 : 1);
+		}
+		close(fds[1]);
+		running.push_back({pid, fds[0], i});
+	}
+	for (const Child &child : running)
+		collect(child);
+
+	int ret = 0;
+	printf("%10s %10s %12s %12s %8s %12s %12s %12s %9s\n", "data_bytes", "code_bytes", "cycles",
+	       "instret", "cpi", "code_misses", "data_misses", "writebacks", "exit_code");
+	for (size_t i = 0; i < configs.size(); i++)
+	{
+		if (!results[i])
+		{
+			fprintf(stderr, "ERROR: sweep: the child running %zu:%zu did not report its statistics\n",
+			        configs[i].dataBytes, configs[i].codeBytes);
+			ret = 1;
+			continue;
+		}
+
+		const SweepResult &result = *results[i];
+		printf("%10zu %10zu %12lu %12lu %8.3f %12lu %12lu %12lu %9d\n",
+		       result.config.dataBytes, result.config.codeBytes,
+		       (unsigned long) result.cycles, (unsigned long) result.instret,
+		       result.instret ? double(result.cycles) / result.instret : 0.0,
+		       (unsigned long) result.stats.codeMisses, (unsigned long) result.stats.dataMisses,
+		       (unsigned long) result.stats.writebacks, result.exitCode);
+		if (result.exitCode != 0)
+			ret = result.exitCode;
+	}
+	return ret;
+}
+
+// Samples the program from reset, then repeats the run with a shorter period as long as
+// the confidence interval misses the target and more samples can still be taken
+template<typename Memory>
+static int RunSampled(const Options &opts, FILE *guestOutput, const std::vector<char> &generated)
+{
+	static constexpr int maxPasses = 4;
+	SampleConfig config = opts.sampleConfig;
+	SampleReport report;
+	HostState host;
+
+	for (int pass = 1; pass <= maxPasses; pass++)
+	{
+		MemoryStorage mem(opts.guestMemoryBytes);
+		Memory cache(mem);
+		BasicCpu<Memory> cpu {cache};
+		if (!LoadProgram(mem, opts, generated) || !Preload(mem, opts.preloads))
+			return 1;
+		cpu.Reset(0x200);
+
+		// Every pass gets the whole limit
+		if (opts.maxCycles != 0 || opts.timeoutSeconds > 0)
+			cpu.GetHostProfiler().EnableWatchdog(opts.maxCycles, opts.timeoutSeconds);
+		cpu.GetHostProfiler().Start();
+
+		host = HostState();
+		host.output = guestOutput;
+		host.io = &mem.GetHostIo();
+		host.arrayPrefix = opts.resultArrayPrefix;
+		host.quiet = pass > 1;
+		report = Sampler(cpu, cache, config).Run(host);
+		FlushGuestOutput(host);
+		// Every pass runs the guest to completion, the last one leaves its dumps behind
+		if (!DumpMemory(cache, mem, opts.memoryDumps))
+			return 1;
+
+		size_t required = report.RequiredSamples(config.targetError);
+		fprintf(stderr, "sampling pass %d: period %u, %zu samples, %zu required\n",
+		        pass, config.period, report.cpi.size(), required);
+		if (report.cpi.size() >= required)
 			break;
+
+		// The densest possible sampling still has a functionally warmed gap between windows
+		Word period = std::max(Word(std::min<uint64_t>(report.instret / required, config.period)),
+		                       config.warmup + config.window + 1);
+		if (period >= config.period)
+			break;
+		config.period = period;
+	}
+
+	double mean = report.Mean();
+	double halfWidth = report.HalfWidth();
+	printf("samples    %zu\n", report.cpi.size());
+	printf("period     %u\n", config.period);
+	printf("instret    %lu\n", (unsigned long) report.instret);
+	printf("cpi        %.4f +- %.4f (95%% confidence, +-%.2f%%)\n",
+	       mean, halfWidth, mean ? 100.0 * halfWidth / mean : 0.0);
+	printf("cycles     %.0f (estimated)\n", mean * report.instret);
+	return host.exitCode;
+}
+
+// One line per record: pc, instruction word, destination register and value, and the
+// kind, address and data of a memory access
+static int PrintTrace(const std::string &filename)
+{
+	TraceReader reader;
+	if (!reader.Open(filename))
+		return 1;
+
+	TraceRecord record;
+	while (reader.Next(record))
+	{
+		printf("0x%08x 0x%08x", record.pc, record.insn);
+		if (record.hasDst)
+			printf(" x%u=0x%08x", unsigned(record.rd), record.dstValue);
+		if (record.load || record.store)
+			printf(" %s 0x%08x 0x%08x", record.load ? "ld" : "st", record.addr, record.data);
+		printf("\n");
+	}
+	return reader.Ok() ? 0 : 1;
+}
+
+// Drives a fresh memory model with a captured access stream and reports its statistics
+// (to stdout unless --stats names a file)
+static int RunReplay(const Options &opts)
+{
+	AccessTraceReader trace;
+	if (!trace.Open(opts.replayFile))
+		return 1;
+
+	MemoryStorage mem;
+	StatsRegistry stats;
+	std::unique_ptr<IMemory> model;
+	if (opts.replayUncached)
+	{
+		auto uncached = new UncachedMemory(mem);
+		uncached->RegisterStats(stats);
+		model.reset(uncached);
+	}
+	else
+	{
+		auto cached = new CachedMemory(mem, opts.replayCache);
+		cached->RegisterStats(stats);
+		model.reset(cached);
+	}
+
+	uint64_t accesses = trace.end() - trace.begin();
+	uint64_t cycles = ReplayAccesses(trace, *model);
+	stats.AddCounter("replay.accesses", accesses);
+	stats.AddCounter("replay.cycles", cycles);
+	return stats.Dump(opts.statsFile.empty() ? "-" : opts.statsFile, opts.statsFormat) ? 0 : 1;
+}
+
+// Runs the program on the memory model `Memory`, with everything the options ask for
+template<typename Memory>
+static int RunProgram(const Options &opts, FILE *guestOutput, const std::vector<char> &generated)
+{
+	// Checkpoints, sweeps and the cache observers only exist for the cached model;
+	// ParseOptions rejects them for the others
+	constexpr bool cached = std::is_same_v<Memory, CachedMemory>;
+
+	MemoryStorage mem(opts.guestMemoryBytes);
+	std::unique_ptr<Memory> memModelPtr(new Memory(mem));
+	BasicCpu<Memory> cpu {*memModelPtr};
+	if (!opts.restoreFile.empty())
+	{
+		if constexpr (cached)
+		{
+			if (!RestoreCheckpoint(opts.restoreFile, cpu, *memModelPtr, mem))
+				return 1;
 		}
-		else if (type == CpuToHostType::PrintChar)
+	}
+	else
+	{
+		if (!LoadProgram(mem, opts, generated) || !Preload(mem, opts.preloads))
+			return 1;
+		cpu.Reset(0x200);
+	}
+
+	StatsRegistry stats;
+	cpu.RegisterStats(stats);
+	memModelPtr->RegisterStats(stats);
+	if constexpr (cached)
+	{
+		stats.AddFormula("cache.code_mpki", [&stats] {
+			return StatsRegistry::Ratio(1000 * stats.Value("cache.code_misses"), stats.Value("csr.instret"));
+		});
+		stats.AddFormula("cache.data_mpki", [&stats] {
+			return StatsRegistry::Ratio(1000 * stats.Value("cache.data_misses"), stats.Value("csr.instret"));
+		});
+	}
+
+	HostProfiler &hostProfiler = cpu.GetHostProfiler();
+	hostProfiler.RegisterStats(stats);
+	if (opts.hostProfile)
+		hostProfiler.EnableSampling();
+	if (opts.progressSeconds > 0)
+		hostProfiler.EnableProgress(opts.progressSeconds);
+	if (opts.maxCycles != 0 || opts.timeoutSeconds > 0)
+		hostProfiler.EnableWatchdog(opts.maxCycles, opts.timeoutSeconds);
+
+	std::unique_ptr<Profiler> profiler;
+	if (opts.profile)
+	{
+		profiler.reset(new Profiler(mem.GetTextBegin(), mem.GetTextEnd()));
+		cpu.SetProfiler(profiler.get());
+	}
+
+	std::unique_ptr<CallGraphProfiler> callGraph;
+	if (!opts.callGraphFile.empty())
+	{
+		callGraph.reset(new CallGraphProfiler());
+		cpu.SetCallGraphProfiler(callGraph.get());
+	}
+
+	std::unique_ptr<MissClassifier> missClassifier;
+	std::unique_ptr<StackDistanceProfiler> stackDistance;
+	std::unique_ptr<LocalityProfiler> locality;
+	std::unique_ptr<AccessCapture> capture;
+	if constexpr (cached)
+	{
+		if (opts.missClasses)
+		{
+			missClassifier.reset(new MissClassifier(memModelPtr->GetConfig()));
+			memModelPtr->AddObserver(missClassifier.get());
+		}
+
+		if (opts.stackDistance)
+		{
+			stackDistance.reset(new StackDistanceProfiler(opts.stackDistanceSets));
+			memModelPtr->AddObserver(stackDistance.get());
+		}
+
+		if (opts.locality)
+		{
+			locality.reset(new LocalityProfiler(mem.GetSymbols(), opts.localityInterval));
+			memModelPtr->AddObserver(locality.get());
+		}
+
+		if (!opts.captureFile.empty())
 		{
-			fprintf(stderr, "%c", (char) data);
+			capture.reset(new AccessCapture(*memModelPtr));
+			if (!capture->Open(opts.captureFile))
+				return 1;
+			memModelPtr->AddObserver(capture.get());
 		}
-		else if (type == CpuToHostType::PrintIntLow)
+	}
+
+	TraceWriter trace;
+	if (!opts.traceFile.empty())
+	{
+		if (!trace.Open(opts.traceFile, opts.traceCompress))
+			return 1;
+		cpu.SetTrace(&trace);
+	}
+
+	HostState host;
+	host.output = guestOutput;
+	host.io = &mem.GetHostIo();
+	host.arrayPrefix = opts.resultArrayPrefix;
+	hostProfiler.Start();
+	bool exited = opts.fastForwardTo.IsSet()
+	              && FastForward(cpu, *memModelPtr, opts.fastForwardTo, opts.warmFrom, host);
+
+	if constexpr (cached)
+	{
+		if (!exited && !opts.checkpointFile.empty())
 		{
-			print_int = uint32_t(data);
+			exited = RunUntil(cpu, *memModelPtr, opts.checkpointAt, host);
+			if (!exited && !SaveCheckpoint(opts.checkpointFile, cpu, *memModelPtr, mem))
+				return 1;
 		}
-		else if (type == CpuToHostType::PrintIntHigh)
+
+		if (!exited && !opts.sweepConfigs.empty())
 		{
-			print_int |= uint32_t(data) << 16;
-			fprintf(stderr, "%d", print_int);
+			// Without a marker every configuration starts from reset
+			if (!opts.sweepAt.IsSet() || !RunUntil(cpu, *memModelPtr, opts.sweepAt, host))
+			{
+				// Otherwise every child would write the pending output again
+				FlushGuestOutput(host);
+				fflush(host.output);
+				return RunSweep(cpu, *memModelPtr, opts.sweepConfigs);
+			}
+			exited = true;
 		}
 	}
+
+	if (!exited)
+		RunUntil(cpu, *memModelPtr, Marker(), host);
+	hostProfiler.Stop();
+	FlushGuestOutput(host);
+
+	if (opts.hostProfile)
+		hostProfiler.Report(stdout, cpu.GetInstret(), cpu.GetCycle());
+	if (profiler)
+		profiler->Report(stdout, mem.GetSymbols(), mem, opts.profileTop);
+	if (missClassifier)
+		missClassifier->Report(stdout, mem.GetSymbols(), opts.profileTop);
+	if (stackDistance)
+		stackDistance->Report(stdout);
+	if (locality)
+		locality->Report(stdout, opts.profileTop);
+	if (!trace.Close() || (capture && !capture->Close()))
+		return 1;
+	if (callGraph && !callGraph->Write(opts.callGraphFile, mem.GetSymbols()))
+		return 1;
+	if (!DumpMemory(*memModelPtr, mem, opts.memoryDumps))
+		return 1;
+	if (!opts.statsFile.empty() && !stats.Dump(opts.statsFile, opts.statsFormat))
+		return 1;
+	return host.exitCode;
+}
+
+int main(int argc, char **argv)
+{
+	Options opts;
+	if (!ParseOptions(argc, argv, opts))
+		return 1;
+
+	// Left open until exit, which flushes it
+	FILE *guestOutput = stderr;
+	if (!opts.guestOutputFile.empty() && !(guestOutput = fopen(opts.guestOutputFile.c_str(), "w")))
+	{
+		fprintf(stderr, "ERROR: cannot open guest output file %s\n", opts.guestOutputFile.c_str());
+		return 1;
+	}
+
+	std::vector<char> generated;
+	if (!opts.generateSpec.empty() && !ProgramGenerator().Generate(opts.generateSpec, generated))
+		return 1;
+	if (!opts.generateOut.empty())
+	{
+		FILE *file = fopen(opts.generateOut.c_str(), "wb");
+		bool written = file != nullptr && fwrite(generated.data(), 1, generated.size(), file) == generated.size();
+		if (file != nullptr && fclose(file) != 0)
+			written = false;
+		if (!written)
+			fprintf(stderr, "ERROR: failed writing generated program \"%s\"\n", opts.generateOut.c_str());
+		return written ? 0 : 1;
+	}
+
+	if (opts.sample && opts.uncached)
+		return RunSampled<UncachedMemory>(opts, guestOutput, generated);
+	if (opts.sample)
+		return RunSampled<CachedMemory>(opts, guestOutput, generated);
+	if (!opts.tracePrintFile.empty())
+		return PrintTrace(opts.tracePrintFile);
+	if (!opts.replayFile.empty())
+		return RunReplay(opts);
+
+	if (opts.uncached)
+		return RunProgram<UncachedMemory>(opts, guestOutput, generated);
+	return RunProgram<CachedMemory>(opts, guestOutput, generated);
 }
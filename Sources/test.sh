@@ -7,6 +7,7 @@ if [ -z $testResponse ]; then
     echo "1) asm tests"
     echo "2) small benchmarks"
     echo "3) big benchmarks"
+    echo "4) generated workloads"
     read testResponse
 fi
 
@@ -47,6 +48,24 @@ case $testResponse in
 	        vvadd
 #               towers
 	     ); vmh_dir=programs/build/bigbenchmarks/bin;;
+    4) # --generate specs; deps loops of 1023 and 1024 instructions straddle the reach
+       # of the loop-closing branch, longer ones close with a jal
+       generated_tests=(
+	        chase stream branch calls deps
+	        deps:length=1023,iterations=5
+	        deps:length=1024,iterations=5
+	        deps:chains=4,length=300,iterations=3
+	        deps:chains=8,length=1024,iterations=3
+	     );
+       for spec in ${generated_tests[@]}; do
+           if ${exe_file} --generate ${spec} > /dev/null 2>&1; then
+               echo "PASSED ${spec}"
+           else
+               echo "FAILED ${spec}"
+               failed=1
+           fi
+       done
+       exit ${failed:-0};;
     *)  echo "ERROR: Unexpected response: $response" ; exit ;;
 esac
 